@@ -0,0 +1,148 @@
+/*
+ * messaging::Queue against the mutex queue it replaced. Every producer
+ * sends what a capture thread does per wakeup, four frames and a commit,
+ * and a single consumer dispatches them by type. Flooding measures
+ * throughput with the ring full most of the time, pacing the delay from
+ * push to dispatch at a camera's rate
+ */
+#include "message.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Frame
+{
+    int camIndex;
+    int index;
+    int64_t timestamp;
+    void* start;
+};
+
+struct Commit
+{
+    int count;
+};
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ns per message
+template<typename Q>
+double flood(int producers, int rounds)
+{
+    Q q;
+    const int cameras = 4;
+    int64_t expected = static_cast<int64_t>(producers) * rounds * (cameras + 1);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&q, rounds, p] {
+            for (int r = 0; r < rounds; r++) {
+                for (int cam = 0; cam < cameras; cam++) {
+                    q.push(Frame{cam, r, r, nullptr});
+                }
+                q.push(Commit{p});
+            }
+        });
+    }
+
+    int64_t frames = 0, commits = 0;
+    for (int64_t i = 0; i < expected; i++) {
+        q.waitAndConsume([&](messaging::MessageBase* msg) {
+            if (msg->type == &messaging::TypeTag<Frame>::id)
+                frames++;
+            else if (msg->type == &messaging::TypeTag<Commit>::id)
+                commits++;
+            return true;
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (frames + commits != expected) {
+        std::fprintf(stderr, "lost messages\n");
+        std::exit(1);
+    }
+
+    return elapsed.count() / expected;
+}
+
+// mean ns from push to dispatch, a burst per producer every interval
+template<typename Q>
+double paced(int producers, int rounds, std::chrono::microseconds interval)
+{
+    Q q;
+    const int cameras = 4;
+    int64_t expected = static_cast<int64_t>(producers) * rounds * (cameras + 1);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&q, rounds, interval, p] {
+            for (int r = 0; r < rounds; r++) {
+                for (int cam = 0; cam < cameras; cam++) {
+                    q.push(Frame{cam, r, nowNs(), nullptr});
+                }
+                q.push(Commit{p});
+                std::this_thread::sleep_for(interval);
+            }
+        });
+    }
+
+    int64_t delay = 0, frames = 0;
+    for (int64_t i = 0; i < expected; i++) {
+        q.waitAndConsume([&](messaging::MessageBase* msg) {
+            if (msg->type == &messaging::TypeTag<Frame>::id) {
+                auto frame = static_cast<messaging::WrappedMessage<Frame>*>(msg);
+                delay += nowNs() - frame->contents.timestamp;
+                frames++;
+            }
+            return true;
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    return static_cast<double>(delay) / frames;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200000;
+    if (rounds < 100) {
+        std::fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-10s %-6s %14s %14s\n", "producers", "queue",
+                "flood ns/msg", "paced ns");
+    for (int producers : {1, 2, 4}) {
+        std::printf("%-10d %-6s %14.1f %14.1f\n", producers, "mutex",
+                    flood<messaging::MutexQueue>(producers, rounds),
+                    paced<messaging::MutexQueue>(producers, rounds / 100,
+                            std::chrono::microseconds(500)));
+        std::printf("%-10d %-6s %14.1f %14.1f\n", producers, "ring",
+                    flood<messaging::Queue>(producers, rounds),
+                    paced<messaging::Queue>(producers, rounds / 100,
+                            std::chrono::microseconds(500)));
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "camerahealth.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+CameraHealth::CameraHealth(FrameSource& source_, int cam_, int64_t stallUs_,
+                           Notify notify_) :
+    source(source_),
+    cam(cam_),
+    stallUs(stallUs_),
+    notify(notify_)
+{}
+
+CameraHealth::~CameraHealth()
+{
+    if (reopening.joinable())
+        reopening.join();
+}
+
+void CameraHealth::start(int64_t nowUs)
+{
+    try {
+        source.start();
+    } catch (const std::exception& e) {
+        fail(nowUs, e.what());
+    }
+}
+
+std::shared_ptr<PixelBufferBase> CameraHealth::dequeue(int64_t nowUs)
+{
+    std::shared_ptr<PixelBufferBase> frame;
+
+    try {
+        frame = source.dequeBuffer();
+    } catch (const std::exception& e) {
+        fail(nowUs, e.what());
+        return nullptr;
+    }
+
+    if (frame)
+        lastFrameUs = nowUs;
+
+    return frame;
+}
+
+void CameraHealth::watch(int64_t nowUs)
+{
+    watching = true;
+    lastFrameUs = nowUs;
+}
+
+void CameraHealth::unwatch()
+{
+    watching = false;
+}
+
+bool CameraHealth::checkStall(int64_t nowUs)
+{
+    if (isLost() || !watching || !stallUs || nowUs - lastFrameUs < stallUs)
+        return false;
+
+    fail(nowUs, "no frames");
+    return true;
+}
+
+bool CameraHealth::retry(int64_t nowUs)
+{
+    if (!isLost() || !source.canReopen())
+        return false;
+
+    if (!reopening.joinable()) {
+        if (nowUs >= retryUs)
+            startReopen();
+        return false;
+    }
+
+    if (!reopenDone.load(std::memory_order_acquire))
+        return false;
+    reopening.join();
+
+    if (reopenFailed) {
+        backoffUs = backoffUs ? backoffUs * 2 : minBackoffUs;
+        if (backoffUs > maxBackoffUs)
+            backoffUs = maxBackoffUs;
+        retryUs = nowUs + backoffUs;
+        return false;
+    }
+
+    std::cerr << "camera " << cam << ": reconnected" << std::endl;
+
+    backoffUs = 0;
+    lastFrameUs = nowUs;
+    reconnectCount.fetch_add(1, std::memory_order_relaxed);
+    lost.store(false, std::memory_order_relaxed);
+    notify(cam, false);
+
+    return true;
+}
+
+int CameraHealth::timeoutMs(int64_t nowUs) const
+{
+    int64_t due;
+
+    if (isLost() && reopening.joinable())
+        due = nowUs + reopenPollUs;
+    else if (isLost() && source.canReopen())
+        due = retryUs;
+    else if (isLost())
+        return -1;
+    else if (watching && stallUs)
+        due = lastFrameUs + stallUs;
+    else
+        return -1;
+
+    int64_t left = due - nowUs;
+    return left <= 0 ? 0 : static_cast<int>((left + 999) / 1000);
+}
+
+// the first attempt to reopen follows right away
+void CameraHealth::fail(int64_t nowUs, const char* what)
+{
+    std::cerr << "camera " << cam << ": lost, " << what << std::endl;
+
+    retryUs = nowUs;
+    backoffUs = 0;
+    lostCount.fetch_add(1, std::memory_order_relaxed);
+    lost.store(true, std::memory_order_relaxed);
+    notify(cam, true);
+}
+
+void CameraHealth::startReopen()
+{
+    reopenDone.store(false, std::memory_order_relaxed);
+    reopening = std::thread([this]
+        {
+            try {
+                source.reopen();
+                reopenFailed = false;
+            } catch (const std::exception&) {
+                reopenFailed = true;
+            }
+            reopenDone.store(true, std::memory_order_release);
+        });
+}
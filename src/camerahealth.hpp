@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <cstdint>
+
+#include "message.hpp"
+#include "framesource.hpp"
+
+/*
+ * health of one camera as seen by the thread dequeuing it. A source whose
+ * dequeue throws, or that stays silent for the stall timeout while it is
+ * watched, is lost: the caller stops polling it and retry() reopens it with
+ * an exponential backoff until it streams again. The reopen runs on a
+ * helper thread, opening a device can block for long and the thread
+ * calling retry() may be dequeuing the other cameras meanwhile, which are
+ * not touched by any of this.
+ */
+class CameraHealth
+{
+public:
+    // lost is told on every change of state, from the capturing thread
+    using Notify = std::function<void(int cam, bool lost)>;
+
+    // a stallUs of 0 never declares a silent camera lost
+    CameraHealth(FrameSource& source_, int cam_, int64_t stallUs_,
+                 Notify notify_);
+    CameraHealth(const CameraHealth&) = delete;
+    CameraHealth& operator=(const CameraHealth&) = delete;
+    // waits for a reopen still running
+    ~CameraHealth();
+
+    FrameSource& getSource()
+    {
+        return source;
+    }
+
+    // starts the source, which is lost right away when that fails
+    void start(int64_t nowUs);
+
+    // null when no frame is ready, or when the source just failed
+    std::shared_ptr<PixelBufferBase> dequeue(int64_t nowUs);
+
+    // the stall timeout runs while the camera is polled
+    void watch(int64_t nowUs);
+    void unwatch();
+    // true when the camera was just found stalled
+    bool checkStall(int64_t nowUs);
+
+    /*
+     * once the backoff passed starts reopening the source, later calls
+     * pick up how that went. True when the camera streams again, its fd
+     * may have changed
+     */
+    bool retry(int64_t nowUs);
+
+    // until the next retry or stall check, -1 without one
+    int timeoutMs(int64_t nowUs) const;
+
+    bool isLost() const
+    {
+        return lost.load(std::memory_order_relaxed);
+    }
+    uint64_t getLostCount() const
+    {
+        return lostCount.load(std::memory_order_relaxed);
+    }
+    uint64_t getReconnectCount() const
+    {
+        return reconnectCount.load(std::memory_order_relaxed);
+    }
+
+    // the earlier of two poll timeouts, -1 meaning none
+    static int earliest(int a, int b)
+    {
+        if (a < 0)
+            return b;
+        if (b < 0)
+            return a;
+        return a < b ? a : b;
+    }
+
+private:
+    static const int64_t minBackoffUs = 50000;
+    static const int64_t maxBackoffUs = 1000000;
+    // how often a reopen in progress is checked on
+    static const int64_t reopenPollUs = 10000;
+
+    FrameSource& source;
+    const int cam;
+    const int64_t stallUs;
+    Notify notify;
+
+    bool watching = false;
+    int64_t lastFrameUs = 0;
+    int64_t retryUs = 0;
+    int64_t backoffUs = 0;
+
+    // the source is only touched by the helper while it runs, the caller
+    // does not poll a lost camera
+    std::thread reopening;
+    std::atomic<bool> reopenDone{false};
+    bool reopenFailed = false;
+
+    std::atomic<bool> lost{false};
+    std::atomic<uint64_t> lostCount{0};
+    std::atomic<uint64_t> reconnectCount{0};
+
+    void fail(int64_t nowUs, const char* what);
+    void startReopen();
+};
@@ -0,0 +1,155 @@
+#include "capturethread.hpp"
+
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+CaptureThread::CaptureThread(CameraHealth& camera_, FrameStage& stage_,
+                             size_t camNum, const Config& config_,
+                             Poller::Backend backend) :
+    camera(camera_),
+    stage(stage_),
+    config(config_),
+    poller(createPoller(backend)),
+    set(camNum)
+{
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd == -1) {
+        throw std::runtime_error("failed to create stop eventfd");
+    }
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        ::close(stopFd);
+        throw std::runtime_error("failed to create wake eventfd");
+    }
+
+    poller->add(stopFd, StopEvent);
+    poller->add(wakeFd, WakeEvent);
+}
+
+CaptureThread::~CaptureThread()
+{
+    stop();
+    ::close(wakeFd);
+    ::close(stopFd);
+}
+
+void CaptureThread::start()
+{
+    thread = std::thread(&CaptureThread::run, this);
+}
+
+void CaptureThread::stop()
+{
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(stopFd, &one, sizeof(one));
+        (void)ret;
+        thread.join();
+    }
+}
+
+void CaptureThread::setPolled(bool on)
+{
+    if (polled.exchange(on, std::memory_order_release) == on)
+        return;
+
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeFd, &one, sizeof(one));
+    (void)ret;
+}
+
+// a lost camera's fd is dropped before it is reopened, which closes it
+void CaptureThread::updatePolling()
+{
+    bool on = polled.load(std::memory_order_acquire) && !camera.isLost();
+    if ((polledFd != -1) == on)
+        return;
+
+    if (on) {
+        polledFd = camera.getSource().getFd();
+        poller->add(polledFd, FrameEvent);
+        camera.watch(FrameSync::now());
+    } else {
+        poller->remove(polledFd, FrameEvent);
+        polledFd = -1;
+        camera.unwatch();
+    }
+}
+
+void CaptureThread::applyConfig()
+{
+    if (config.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err) {
+            std::cerr << "capture thread: cpu " << config.cpu << ": "
+                      << std::strerror(err) << std::endl;
+        }
+    }
+
+    if (config.priority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = config.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err) {
+            // EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+            std::cerr << "capture thread: SCHED_FIFO " << config.priority
+                      << ": " << std::strerror(err) << std::endl;
+        }
+    }
+}
+
+void CaptureThread::run()
+{
+    applyConfig();
+
+    updatePolling();
+
+    uint32_t ready[3];
+    bool stopping = false;
+    while (!stopping) {
+        int timeout = CameraHealth::earliest(stage.timeoutMs(),
+                                             camera.timeoutMs(FrameSync::now()));
+        int nevent = poller->wait(ready, 3, timeout);
+
+        for (int i = 0; i < nevent; i++) {
+            if (ready[i] == StopEvent) {
+                stopping = true;
+                continue;
+            }
+            if (ready[i] == WakeEvent) {
+                uint64_t count;
+                ssize_t ret = ::read(wakeFd, &count, sizeof(count));
+                (void)ret;
+                continue;
+            }
+            if (polledFd == -1)
+                continue;
+
+            std::shared_ptr<PixelBufferBase> pb(camera.dequeue(FrameSync::now()));
+            if (pb)
+                stage.put(std::move(pb), set);
+        }
+
+        int64_t now = FrameSync::now();
+        camera.checkStall(now);
+        updatePolling();
+        if (camera.retry(now))
+            updatePolling();
+
+        stage.flushExpired(set);
+    }
+
+    if (polledFd != -1) {
+        poller->remove(polledFd, FrameEvent);
+        polledFd = -1;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "camerahealth.hpp"
+#include "framestage.hpp"
+#include "poller.hpp"
+
+/*
+ * dequeues a single camera on a thread of its own, so scheduling jitter of
+ * one camera's thread does not delay the others' buffers. The thread can
+ * be pinned to a cpu and run SCHED_FIFO, when the process may not raise
+ * its priority it keeps running with the default policy. A lost camera is
+ * reopened on a helper thread, its own thread polls the new fd once it is
+ * back. A camera nobody looks at is not polled, its buffers then wait in
+ * the driver.
+ */
+class CaptureThread
+{
+public:
+    struct Config
+    {
+        // -1 for any
+        int cpu = -1;
+        // SCHED_FIFO priority, 0 keeps SCHED_OTHER
+        int priority = 0;
+    };
+
+    CaptureThread(CameraHealth& camera_, FrameStage& stage_, size_t camNum,
+                  const Config& config_, Poller::Backend backend);
+    CaptureThread(const CaptureThread&) = delete;
+    CaptureThread& operator=(const CaptureThread&) = delete;
+    ~CaptureThread();
+
+    void start();
+    void stop();
+    // whether the camera is dequeued, the thread picks the change up at
+    // once
+    void setPolled(bool on);
+
+    const Config& getConfig() const
+    {
+        return config;
+    }
+
+private:
+    enum Event : uint32_t
+    {
+        FrameEvent,
+        StopEvent,
+        WakeEvent,
+    };
+
+    CameraHealth& camera;
+    FrameStage& stage;
+    Config config;
+    std::unique_ptr<Poller> poller;
+    std::vector<FrameSync::Frame> set;
+    int stopFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> polled{true};
+    // the source fd being polled, -1 while the camera is lost or not
+    // polled
+    int polledFd = -1;
+    std::thread thread;
+
+    void run();
+    void applyConfig();
+    void updatePolling();
+};
@@ -0,0 +1,223 @@
+#include "fisheye.hpp"
+
+#include <stdexcept>
+
+namespace fisheye {
+// the focal length and center scale with the frame they are applied to
+static cv::Matx33d scaleToSensor(const Intrinsics& intrinsics, cv::Size sensor)
+{
+    cv::Matx33d K = intrinsics.K;
+    double sx = static_cast<double>(sensor.width) / intrinsics.size.width;
+    double sy = static_cast<double>(sensor.height) / intrinsics.size.height;
+    K(0, 0) *= sx;
+    K(0, 2) *= sx;
+    K(1, 1) *= sy;
+    K(1, 2) *= sy;
+
+    return K;
+}
+
+std::vector<Intrinsics> loadCalibration(const std::string& path, int cameraNum)
+{
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        throw std::runtime_error("failed to open calibration: " + path);
+    }
+
+    std::vector<Intrinsics> cameras;
+    for (int i = 0; i < cameraNum; i++) {
+        std::string name("camera_" + std::to_string(i));
+        cv::FileNode node = fs[name];
+        if (node.empty()) {
+            throw std::runtime_error(path + ": no " + name);
+        }
+
+        cv::Mat K, D;
+        int width = 0, height = 0;
+        node["camera_matrix"] >> K;
+        node["distortion_coefficients"] >> D;
+        node["image_width"] >> width;
+        node["image_height"] >> height;
+        if (K.rows != 3 || K.cols != 3 || D.total() != 4 ||
+            width <= 0 || height <= 0) {
+            throw std::runtime_error(path + ": invalid " + name);
+        }
+
+        Intrinsics intrinsics;
+        K.convertTo(K, CV_64F);
+        D.convertTo(D, CV_64F);
+        intrinsics.K = cv::Matx33d(K.ptr<double>());
+        intrinsics.D = cv::Vec4d(D.ptr<double>());
+        intrinsics.size = cv::Size(width, height);
+        cameras.push_back(intrinsics);
+    }
+
+    return cameras;
+}
+
+std::vector<float> buildRemapTable(const Intrinsics& intrinsics,
+                                   cv::Size sensor, cv::Rect frame,
+                                   cv::Size tableSize, double balance)
+{
+    cv::Matx33d K = scaleToSensor(intrinsics, sensor);
+
+    cv::Matx33d P;
+    cv::fisheye::estimateNewCameraMatrixForUndistortRectify(
+            K, intrinsics.D, sensor, cv::Matx33d::eye(), P, balance,
+            tableSize);
+
+    // sensor pixel each table entry samples, centers at integers
+    cv::Mat map, unused;
+    cv::fisheye::initUndistortRectifyMap(K, intrinsics.D, cv::Matx33d::eye(),
+                                         P, tableSize, CV_32FC2, map, unused);
+
+    // left unclamped, so interpolating between entries stays right at the
+    // edges of the frame
+    std::vector<float> table(tableSize.area() * 2);
+    float* out = table.data();
+    for (int y = 0; y < map.rows; y++) {
+        const cv::Vec2f* row = map.ptr<cv::Vec2f>(y);
+        for (int x = 0; x < map.cols; x++) {
+            *out++ = (row[x][0] - frame.x + 0.5f) / frame.width;
+            *out++ = (row[x][1] - frame.y + 0.5f) / frame.height;
+        }
+    }
+
+    return table;
+}
+
+Surround loadSurround(const std::string& path, int cameraNum)
+{
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        throw std::runtime_error("failed to open calibration: " + path);
+    }
+
+    Surround surround;
+    if (fs["surround_width"].empty() && fs["surround_height"].empty())
+        return surround;
+
+    int width = 0, height = 0;
+    fs["surround_width"] >> width;
+    fs["surround_height"] >> height;
+    if (width <= 0 || height <= 0) {
+        throw std::runtime_error(path + ": invalid surround size");
+    }
+    surround.size = cv::Size(width, height);
+
+    for (int i = 0; i < cameraNum; i++) {
+        std::string name("camera_" + std::to_string(i));
+        cv::Mat H;
+        fs[name]["ground_homography"] >> H;
+        if (H.rows != 3 || H.cols != 3) {
+            throw std::runtime_error(path + ": no ground_homography in " + name);
+        }
+
+        H.convertTo(H, CV_64F);
+        surround.ground.push_back(cv::Matx33d(H.ptr<double>()));
+
+        double gain = 1.0;
+        if (!fs[name]["gain"].empty())
+            fs[name]["gain"] >> gain;
+        if (gain <= 0.0) {
+            throw std::runtime_error(path + ": invalid gain in " + name);
+        }
+        surround.gain.push_back(gain);
+    }
+
+    return surround;
+}
+
+/*
+ * every camera's texture coordinates over the whole top view come first,
+ * with a mask of where they fall into its frame. The distance to the edge
+ * of that mask weighs the cameras against each other
+ */
+void buildSurroundTable(const std::vector<Intrinsics>& intrinsics,
+                        const Surround& surround, cv::Size sensor,
+                        cv::Rect frame, std::vector<float>& samples,
+                        std::vector<float>& blend)
+{
+    cv::Size size = surround.size;
+    int cameraNum = surround.ground.size();
+    std::vector<cv::Mat2f> coords(cameraNum);
+    std::vector<cv::Mat1f> weights(cameraNum);
+
+    for (int i = 0; i < cameraNum; i++) {
+        cv::Matx33d toNormalized = intrinsics[i].K.inv() * surround.ground[i];
+
+        // ground behind the camera has no image
+        std::vector<cv::Point2d> undistorted;
+        std::vector<uchar> inFront;
+        undistorted.reserve(size.area());
+        inFront.reserve(size.area());
+        for (int y = 0; y < size.height; y++) {
+            for (int x = 0; x < size.width; x++) {
+                cv::Vec3d p = toNormalized * cv::Vec3d(x, y, 1.0);
+                inFront.push_back(p[2] > 0.0);
+                undistorted.push_back(p[2] > 0.0 ?
+                    cv::Point2d(p[0] / p[2], p[1] / p[2]) : cv::Point2d());
+            }
+        }
+
+        std::vector<cv::Point2d> distorted;
+        cv::fisheye::distortPoints(undistorted, distorted,
+                                   scaleToSensor(intrinsics[i], sensor),
+                                   intrinsics[i].D);
+
+        coords[i].create(size);
+        cv::Mat1b mask(size, 0);
+        for (int y = 0, n = 0; y < size.height; y++) {
+            for (int x = 0; x < size.width; x++, n++) {
+                float u = (distorted[n].x - frame.x + 0.5) / frame.width;
+                float v = (distorted[n].y - frame.y + 0.5) / frame.height;
+                coords[i](y, x) = cv::Vec2f(u, v);
+                mask(y, x) = inFront[n] && u > 0.0f && u < 1.0f &&
+                             v > 0.0f && v < 1.0f ? 255 : 0;
+            }
+        }
+        cv::distanceTransform(mask, weights[i], cv::DIST_L2, 3);
+    }
+
+    samples.assign(size.area() * 4, 0.0f);
+    blend.assign(size.area() * 4, 0.0f);
+    for (int y = 0, n = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++, n += 4) {
+            int best[2] = {-1, -1};
+            for (int i = 0; i < cameraNum; i++) {
+                float w = weights[i](y, x);
+                if (w <= 0.0f)
+                    continue;
+                if (best[0] < 0 || w > weights[best[0]](y, x)) {
+                    best[1] = best[0];
+                    best[0] = i;
+                } else if (best[1] < 0 || w > weights[best[1]](y, x)) {
+                    best[1] = i;
+                }
+            }
+
+            if (best[0] < 0) {
+                blend[n] = -1.0f;
+                blend[n + 1] = -1.0f;
+                continue;
+            }
+            // a single camera blends with itself
+            if (best[1] < 0)
+                best[1] = best[0];
+
+            float w0 = weights[best[0]](y, x);
+            float w1 = best[1] != best[0] ? weights[best[1]](y, x) : 0.0f;
+            cv::Vec2f c0 = coords[best[0]](y, x);
+            cv::Vec2f c1 = coords[best[1]](y, x);
+            samples[n] = c0[0];
+            samples[n + 1] = c0[1];
+            samples[n + 2] = c1[0];
+            samples[n + 3] = c1[1];
+            blend[n] = best[0];
+            blend[n + 1] = best[1];
+            blend[n + 2] = w0 / (w0 + w1) * surround.gain[best[0]];
+            blend[n + 3] = w1 / (w0 + w1) * surround.gain[best[1]];
+        }
+    }
+}
+}
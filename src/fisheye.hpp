@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/*
+ * lens correction with OpenCV's fisheye model. The intrinsics of every
+ * camera are loaded once and baked into a lookup table of where each pixel
+ * of the undistorted view samples the captured frame, which the renderer
+ * applies on the gpu.
+ */
+namespace fisheye {
+    struct Intrinsics
+    {
+        cv::Matx33d K;
+        cv::Vec4d D;
+        // the frame size the camera was calibrated at
+        cv::Size size;
+    };
+
+    /*
+     * a cv::FileStorage file (yaml or xml) holding camera_0 .. camera_<n-1>,
+     * each with image_width, image_height, camera_matrix and
+     * distortion_coefficients (k1..k4)
+     */
+    std::vector<Intrinsics> loadCalibration(const std::string& path,
+                                            int cameraNum);
+
+    /*
+     * for Render::setRemapTables, tableSize.width * tableSize.height pairs
+     * of texture coordinates. sensor is the full frame of the camera, frame
+     * the part of it that is captured. balance trades the black border of
+     * the undistorted view (1) against cropping into the image (0).
+     * Pixels that sample outside the frame lie outside 0..1
+     */
+    std::vector<float> buildRemapTable(const Intrinsics& intrinsics,
+                                       cv::Size sensor, cv::Rect frame,
+                                       cv::Size tableSize, double balance);
+
+    /*
+     * the ground around the cameras seen from above, size pixels large.
+     * ground[i] maps a pixel of that top view to where camera i sees it
+     * without distortion, in the pixels the camera was calibrated at.
+     * gain[i] evens out the brightness of camera i against the others
+     */
+    struct Surround
+    {
+        cv::Size size;
+        std::vector<cv::Matx33d> ground;
+        std::vector<double> gain;
+    };
+
+    /*
+     * surround_width and surround_height, and a ground_homography and
+     * optionally a gain in every camera_<i> of the calibration. The size is
+     * empty without them
+     */
+    Surround loadSurround(const std::string& path, int cameraNum);
+
+    /*
+     * for Render::setSurroundTable, per pixel of the top view the texture
+     * coordinates of the two cameras seeing it best in samples (u0 v0 u1 v1)
+     * and in blend which cameras they are and their weights (cam0 cam1 w0
+     * w1). The weights fall off towards the edge of each camera's view
+     * where views overlap and include the camera's gain, cam0 is -1 where
+     * no camera sees the ground
+     */
+    void buildSurroundTable(const std::vector<Intrinsics>& intrinsics,
+                            const Surround& surround, cv::Size sensor,
+                            cv::Rect frame, std::vector<float>& samples,
+                            std::vector<float>& blend);
+}
@@ -0,0 +1,74 @@
+// sampling of the camera frames, shared by shader.frag and compose.comp
+
+// Render::InputFormat
+const int FORMAT_XBGR32 = 0;
+const int FORMAT_YUYV = 1;
+const int FORMAT_NV12 = 2;
+layout(constant_id = 0) const int inputFormat = FORMAT_XBGR32;
+
+layout(binding = 1) uniform sampler2DArray texSampler;
+// CbCr plane of NV12, unused otherwise
+layout(binding = 2) uniform sampler2DArray chromaSampler;
+// per pixel of the top view, layer 0 holds the texture coordinates of two
+// cameras, layer 1 which cameras and their weights, unused without the
+// surround view
+layout(binding = 4) uniform sampler2DArray surroundSampler;
+
+// BT.601, limited range
+vec3 yuvToRgb(float y, float cb, float cr)
+{
+    y = 1.164 * (y - 16.0 / 255.0);
+    cb -= 0.5;
+    cr -= 0.5;
+
+    return vec3(y + 1.596 * cr,
+                y - 0.392 * cb - 0.813 * cr,
+                y + 2.017 * cb);
+}
+
+// explicit lods, compute shaders have no derivatives
+vec4 sampleFrame(vec3 texCoord, bool clip)
+{
+    // black like the sampler border, which is no black in YCbCr, and where
+    // a table has nothing to show
+    if ((clip || inputFormat != FORMAT_XBGR32) &&
+        (any(lessThan(texCoord.xy, vec2(0.0))) ||
+         any(greaterThan(texCoord.xy, vec2(1.0))))) {
+        return vec4(0.0, 0.0, 0.0, 1.0);
+    }
+
+    if (inputFormat == FORMAT_YUYV) {
+        // a texel holds two pixels, Y0 Cb Y1 Cr, so fetch it unfiltered
+        ivec2 size = textureSize(texSampler, 0).xy * ivec2(2, 1);
+        ivec2 pos = min(ivec2(texCoord.xy * vec2(size)), size - 1);
+        vec4 yuyv = texelFetch(texSampler,
+                               ivec3(pos.x / 2, pos.y, int(texCoord.z)), 0);
+        float y = (pos.x & 1) == 0 ? yuyv.r : yuyv.b;
+
+        return vec4(yuvToRgb(y, yuyv.g, yuyv.a), 1.0);
+    } else if (inputFormat == FORMAT_NV12) {
+        float y = textureLod(texSampler, texCoord, 0.0).r;
+        vec2 cbcr = textureLod(chromaSampler, texCoord, 0.0).rg;
+
+        return vec4(yuvToRgb(y, cbcr.r, cbcr.g), 1.0);
+    }
+
+    return textureLod(texSampler, texCoord, 0.0);
+}
+
+// uv spans the top view. Camera indices can not be filtered, so the
+// nearest entry is fetched. The weights carry each camera's gain
+vec4 sampleSurround(vec2 uv)
+{
+    ivec2 size = textureSize(surroundSampler, 0).xy;
+    ivec2 pos = min(ivec2(uv * vec2(size)), size - 1);
+    vec4 samples = texelFetch(surroundSampler, ivec3(pos, 0), 0);
+    vec4 blend = texelFetch(surroundSampler, ivec3(pos, 1), 0);
+
+    if (blend.x < 0.0)
+        return vec4(0.0, 0.0, 0.0, 1.0);
+
+    vec3 color = sampleFrame(vec3(samples.xy, blend.x), true).rgb * blend.z +
+                 sampleFrame(vec3(samples.zw, blend.y), true).rgb * blend.w;
+    return vec4(color, 1.0);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+
+/*
+ * latest-frame-wins hand over from capture to render: one pending frame per
+ * camera. A newer frame releases the one it replaces right away, so that
+ * v4l2 buffer is queued back to the driver instead of waiting behind a slow
+ * renderer. Whatever the render pace, at most one frame per camera is held.
+ */
+class FrameChannel
+{
+public:
+    explicit FrameChannel(int camNum) :
+        pending(camNum),
+        taking(camNum),
+        drops(camNum)
+    {}
+
+    FrameChannel(const FrameChannel&) = delete;
+    FrameChannel& operator=(const FrameChannel&) = delete;
+
+    // the frame's index selects the camera
+    void put(std::shared_ptr<PixelBufferBase>&& frame)
+    {
+        int cam = frame->getIndex();
+        std::shared_ptr<PixelBufferBase> old;
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            old = std::move(pending.at(cam));
+            pending.at(cam) = std::move(frame);
+        }
+
+        // dropped outside the lock, releasing requeues the buffer
+        if (old) {
+            drops[cam].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * a whole frame set at once (one slot per camera, empty slots keep what
+     * is pending), so the consumer never sees half of it. set is left empty
+     */
+    void putSet(std::vector<std::shared_ptr<PixelBufferBase>>& set)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            for (size_t cam = 0; cam < pending.size(); cam++) {
+                if (set[cam])
+                    pending[cam].swap(set[cam]);
+            }
+        }
+
+        // set now holds the replaced frames
+        for (size_t cam = 0; cam < set.size(); cam++) {
+            if (set[cam]) {
+                drops[cam].fetch_add(1, std::memory_order_relaxed);
+                set[cam].reset();
+            }
+        }
+    }
+
+    /*
+     * producer side, true when the consumer has not been told about pending
+     * frames yet, so at most one notification is in flight
+     */
+    bool markReady()
+    {
+        return !ready.exchange(true, std::memory_order_acq_rel);
+    }
+
+    // consumer side, returns the number of frames handed to f
+    template<typename Func>
+    int takeAll(Func&& f)
+    {
+        int taken = 0;
+
+        // cleared first, a frame put after this notifies again
+        ready.store(false, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            pending.swap(taking);
+        }
+
+        for (auto& frame : taking) {
+            if (frame) {
+                f(frame);
+                frame.reset();
+                taken++;
+            }
+        }
+
+        return taken;
+    }
+
+    int size() const
+    {
+        return pending.size();
+    }
+
+    uint64_t getDropCount(int cam) const
+    {
+        return drops.at(cam).load(std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex m;
+    std::vector<std::shared_ptr<PixelBufferBase>> pending;
+    // consumer side only, always empty outside takeAll
+    std::vector<std::shared_ptr<PixelBufferBase>> taking;
+    std::vector<std::atomic<uint64_t>> drops;
+    std::atomic<bool> ready{false};
+};
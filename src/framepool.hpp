@@ -0,0 +1,137 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * fixed number of equally sized blocks, used through PoolAllocator so that
+ * std::allocate_shared puts an object and its control block into one of
+ * them. Only when the pool runs dry, or a request does not fit a block, the
+ * heap is used, which is counted.
+ */
+class FramePool
+{
+public:
+    FramePool(size_t blockSize_, size_t blockNum_) :
+        blockSize(roundUp(blockSize_)),
+        blockNum(blockNum_),
+        storage(new std::max_align_t[blockSize / sizeof(std::max_align_t) * blockNum])
+    {
+        freeBlocks.reserve(blockNum);
+        for (size_t i = 0; i < blockNum; i++) {
+            freeBlocks.push_back(reinterpret_cast<unsigned char*>(storage.get()) +
+                                 i * blockSize);
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void* allocate(size_t size)
+    {
+        if (size <= blockSize) {
+            std::lock_guard<std::mutex> lk(m);
+            if (!freeBlocks.empty()) {
+                void* p = freeBlocks.back();
+                freeBlocks.pop_back();
+                return p;
+            }
+        }
+
+        heapAllocs.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p)
+    {
+        if (owns(p)) {
+            // never grows past the reserved capacity
+            std::lock_guard<std::mutex> lk(m);
+            freeBlocks.push_back(p);
+            return;
+        }
+
+        ::operator delete(p);
+    }
+
+    uint64_t getHeapAllocCount() const
+    {
+        return heapAllocs.load(std::memory_order_relaxed);
+    }
+
+    size_t getBlockNum() const
+    {
+        return blockNum;
+    }
+
+private:
+    const size_t blockSize;
+    const size_t blockNum;
+    std::unique_ptr<std::max_align_t[]> storage;
+    std::vector<void*> freeBlocks;
+    std::mutex m;
+    std::atomic<uint64_t> heapAllocs{0};
+
+    bool owns(void* p) const
+    {
+        auto begin = reinterpret_cast<const unsigned char*>(storage.get());
+        auto ptr = static_cast<const unsigned char*>(p);
+
+        return ptr >= begin && ptr < begin + blockSize * blockNum;
+    }
+
+    static size_t roundUp(size_t n)
+    {
+        return (n + sizeof(std::max_align_t) - 1) /
+               sizeof(std::max_align_t) * sizeof(std::max_align_t);
+    }
+};
+
+template<typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(FramePool* pool_) :
+        pool(pool_)
+    {}
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) :
+        pool(other.pool)
+    {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        pool->deallocate(p);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>& other) const
+    {
+        return pool == other.pool;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>& other) const
+    {
+        return pool != other.pool;
+    }
+
+private:
+    FramePool* pool;
+
+    template<typename U>
+    friend class PoolAllocator;
+};
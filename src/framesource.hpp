@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include <cstdint>
+
+#include "message.hpp"
+
+/*
+ * where a camera's frames come from. The capture loop polls getFd() and
+ * dequeues once it is readable, a frame's memory belongs to the source
+ * again when the last reference to it is dropped.
+ */
+class FrameSource
+{
+public:
+    virtual ~FrameSource() = default;
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    // readable when a frame may be ready
+    virtual int getFd() const = 0;
+    // null when no frame is ready
+    virtual std::shared_ptr<PixelBufferBase> dequeBuffer() = 0;
+    // frames handed out that did not fit the preallocated pool
+    virtual uint64_t getHeapAllocCount() const = 0;
+    // frames lost before they could be dequeued
+    virtual uint64_t getDropCount() const = 0;
+
+    // whether reopen() can bring the source back after dequeueBuffer threw
+    virtual bool canReopen() const
+    {
+        return false;
+    }
+    // starts over from scratch, getFd() may change. Throws on failure
+    virtual void reopen()
+    {
+        throw std::runtime_error("source can not be reopened");
+    }
+};
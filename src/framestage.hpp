@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include "message.hpp"
+#include "framesync.hpp"
+#include "framechannel.hpp"
+#include "jpegdecoder.hpp"
+#include "recorder.hpp"
+
+/*
+ * where dequeued frames go, shared by all capturing threads: to the
+ * recorder while one runs, through the camera's decoder when it delivers
+ * MJPEG, and into the frame sets handed to the renderer. Also keeps how
+ * long after its capture timestamp each camera's frame was dequeued.
+ */
+class FrameStage
+{
+public:
+    // notify tells the renderer about new frames
+    FrameStage(FrameSync& sync_, FrameChannel& frames_,
+               std::function<void()> notify_) :
+        sync(sync_),
+        frames(frames_),
+        notify(notify_),
+        decoders(frames_.size(), nullptr),
+        wakeups(frames_.size())
+    {}
+
+    FrameStage(const FrameStage&) = delete;
+    FrameStage& operator=(const FrameStage&) = delete;
+
+    // before capture starts
+    void setDecoder(size_t cam, JpegDecoder* decoder)
+    {
+        decoders.at(cam) = decoder;
+    }
+
+    // null stops recording, from any thread
+    void setRecorder(std::shared_ptr<Recorder> recorder_)
+    {
+        std::atomic_store(&recorder, std::move(recorder_));
+    }
+
+    bool isRecording() const
+    {
+        return std::atomic_load(&recorder) != nullptr;
+    }
+
+    // set is the calling thread's own, one slot per camera
+    void put(std::shared_ptr<PixelBufferBase>&& frame,
+             std::vector<FrameSync::Frame>& set)
+    {
+        int cam = frame->getIndex();
+        int64_t now = FrameSync::now();
+        wakeups[cam].add(now - frame->getTimestamp());
+
+        std::shared_ptr<Recorder> rec = std::atomic_load(&recorder);
+        if (rec)
+            rec->push(frame);
+
+        if (decoders[cam]) {
+            decoders[cam]->push(std::move(frame));
+            return;
+        }
+        if (sync.put(std::move(frame), now, set))
+            commit(set);
+    }
+
+    // hands over the set being filled once its deadline passed
+    void flushExpired(std::vector<FrameSync::Frame>& set)
+    {
+        if (sync.flushExpired(FrameSync::now(), set))
+            commit(set);
+    }
+
+    // until the deadline of the set being filled, -1 without one
+    int timeoutMs()
+    {
+        return sync.timeoutMs(FrameSync::now());
+    }
+
+    // dequeue time minus capture timestamp, in microseconds
+    int64_t getLastWakeUs(int cam) const
+    {
+        return wakeups.at(cam).last.load(std::memory_order_relaxed);
+    }
+    int64_t getAvgWakeUs(int cam) const
+    {
+        const Wakeup& w = wakeups.at(cam);
+        uint64_t count = w.count.load(std::memory_order_relaxed);
+        return count ? w.total.load(std::memory_order_relaxed) /
+                       static_cast<int64_t>(count) : 0;
+    }
+    int64_t getMaxWakeUs(int cam) const
+    {
+        return wakeups.at(cam).max.load(std::memory_order_relaxed);
+    }
+
+private:
+    // written by the thread capturing the camera only
+    struct Wakeup
+    {
+        std::atomic<int64_t> last{0};
+        std::atomic<int64_t> total{0};
+        std::atomic<int64_t> max{0};
+        std::atomic<uint64_t> count{0};
+
+        void add(int64_t us)
+        {
+            last.store(us, std::memory_order_relaxed);
+            total.fetch_add(us, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            if (us > max.load(std::memory_order_relaxed))
+                max.store(us, std::memory_order_relaxed);
+        }
+    };
+
+    FrameSync& sync;
+    FrameChannel& frames;
+    std::function<void()> notify;
+    std::vector<JpegDecoder*> decoders;
+    std::shared_ptr<Recorder> recorder;
+    std::vector<Wakeup> wakeups;
+
+    void commit(std::vector<FrameSync::Frame>& set)
+    {
+        frames.putSet(set);
+        if (frames.markReady())
+            notify();
+    }
+};
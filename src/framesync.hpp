@@ -0,0 +1,195 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "message.hpp"
+
+/*
+ * groups one frame per active camera into a set whose capture timestamps
+ * lie within the skew window. A camera's newer frame replaces its pending
+ * one, so a camera running ahead waits for the others instead of mixing
+ * capture instants. A set still incomplete once the deadline after its
+ * first frame passed is handed over as it is, so a stalled camera does not
+ * freeze the others. A camera known to be lost is left out of sets until it
+ * is back.
+ */
+class FrameSync
+{
+public:
+    using Frame = std::shared_ptr<PixelBufferBase>;
+
+    FrameSync(int camNum, int64_t skewUs_, int64_t deadlineUs_) :
+        pending(camNum),
+        skewUs(skewUs_),
+        deadlineUs(deadlineUs_),
+        camSkewUs(camNum)
+    {
+        if (camNum > 32)
+            throw std::runtime_error("FrameSync: too many cameras");
+
+        active = camNum == 32 ? ~0U : (1U << camNum) - 1;
+    }
+
+    FrameSync(const FrameSync&) = delete;
+    FrameSync& operator=(const FrameSync&) = delete;
+
+    static int64_t now()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(
+            steady_clock::now().time_since_epoch()).count();
+    }
+
+    // cameras a set has to cover, a partly filled set is dropped
+    void setActive(uint32_t mask)
+    {
+        std::vector<Frame> old(pending.size());
+
+        std::lock_guard<std::mutex> lk(m);
+        active = mask;
+        pending.swap(old);
+        started = false;
+    }
+
+    // a lost camera's pending frame is dropped, sets complete without it
+    void setLost(int cam, bool isLost)
+    {
+        Frame old;
+
+        std::lock_guard<std::mutex> lk(m);
+        if (isLost) {
+            lost |= 1U << cam;
+            old = std::move(pending.at(cam));
+        } else {
+            lost &= ~(1U << cam);
+        }
+    }
+
+    /*
+     * the frame's index selects the camera. Returns true when the frame
+     * completed a set, which is then moved into set (one slot per camera)
+     */
+    bool put(Frame&& frame, int64_t nowUs, std::vector<Frame>& set)
+    {
+        int cam = frame->getIndex();
+        Frame old;
+
+        std::lock_guard<std::mutex> lk(m);
+        if (!((active & ~lost) >> cam & 1)) {
+            old = std::move(frame);
+            return false;
+        }
+
+        old = std::move(pending.at(cam));
+        pending.at(cam) = std::move(frame);
+        if (!started) {
+            started = true;
+            firstArrival = nowUs;
+        }
+
+        if (!complete())
+            return false;
+
+        takeSet(set);
+        completeSets.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // hands over an incomplete set whose deadline passed
+    bool flushExpired(int64_t nowUs, std::vector<Frame>& set)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (!started || nowUs - firstArrival < deadlineUs)
+            return false;
+
+        takeSet(set);
+        expiredSets.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // -1 when no set is being filled, otherwise until its deadline
+    int timeoutMs(int64_t nowUs)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (!started)
+            return -1;
+
+        int64_t left = firstArrival + deadlineUs - nowUs;
+        return left <= 0 ? 0 : static_cast<int>((left + 999) / 1000);
+    }
+
+    // how far the camera lagged the newest frame of the last set
+    int64_t getSkewUs(int cam) const
+    {
+        return camSkewUs.at(cam).load(std::memory_order_relaxed);
+    }
+
+    uint64_t getCompleteCount() const
+    {
+        return completeSets.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getExpiredCount() const
+    {
+        return expiredSets.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex m;
+    std::vector<Frame> pending;
+    uint32_t active;
+    uint32_t lost = 0;
+    bool started = false;
+    int64_t firstArrival = 0;
+    const int64_t skewUs;
+    const int64_t deadlineUs;
+
+    std::vector<std::atomic<int64_t>> camSkewUs;
+    std::atomic<uint64_t> completeSets{0};
+    std::atomic<uint64_t> expiredSets{0};
+
+    bool complete() const
+    {
+        int64_t minTs = std::numeric_limits<int64_t>::max();
+        int64_t maxTs = std::numeric_limits<int64_t>::min();
+
+        for (size_t cam = 0; cam < pending.size(); cam++) {
+            if (!((active & ~lost) >> cam & 1))
+                continue;
+            if (!pending[cam])
+                return false;
+
+            int64_t ts = pending[cam]->getTimestamp();
+            minTs = std::min(minTs, ts);
+            maxTs = std::max(maxTs, ts);
+        }
+
+        return maxTs - minTs <= skewUs;
+    }
+
+    void takeSet(std::vector<Frame>& set)
+    {
+        int64_t newest = std::numeric_limits<int64_t>::min();
+        for (const auto& frame : pending) {
+            if (frame)
+                newest = std::max(newest, frame->getTimestamp());
+        }
+
+        for (size_t cam = 0; cam < pending.size(); cam++) {
+            if (pending[cam]) {
+                camSkewUs[cam].store(newest - pending[cam]->getTimestamp(),
+                                     std::memory_order_relaxed);
+            }
+            set[cam] = std::move(pending[cam]);
+        }
+        started = false;
+    }
+};
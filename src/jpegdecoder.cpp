@@ -0,0 +1,145 @@
+#include "jpegdecoder.hpp"
+
+#include <iostream>
+
+JpegDecoder::JpegDecoder(const std::vector<PixelBufferBase>& slots_,
+                         FrameSync& sync_, FrameChannel& frames_,
+                         std::function<void()> notify_) :
+    slots(slots_),
+    sync(sync_),
+    frames(frames_),
+    notify(notify_),
+    set(frames_.size())
+{
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = errorExit;
+    jpeg_create_decompress(&cinfo);
+}
+
+JpegDecoder::~JpegDecoder()
+{
+    stop();
+    jpeg_destroy_decompress(&cinfo);
+}
+
+void JpegDecoder::start()
+{
+    thread = std::thread(&JpegDecoder::run, this);
+}
+
+void JpegDecoder::stop()
+{
+    if (thread.joinable()) {
+        messaging::Sender(incoming).send(messaging::CloseQueue());
+        thread.join();
+    }
+}
+
+void JpegDecoder::push(std::shared_ptr<PixelBufferBase>&& jpeg)
+{
+    uint64_t seq = pushCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    messaging::Sender(incoming).send(Decode{std::move(jpeg), seq});
+}
+
+void JpegDecoder::run()
+{
+    bool closed = false;
+
+    while (!closed) {
+        incoming.wait(closed)
+            .handle<Decode>(
+                [&](Decode& msg)
+                {
+                    // behind the camera, only the newest frame is worth it
+                    if (msg.seq != pushCount.load(std::memory_order_relaxed)) {
+                        dropCount.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    decode(*msg.jpeg);
+                    // the v4l2 buffer goes back to the driver right away
+                    msg.jpeg.reset();
+                }
+            );
+    }
+}
+
+void JpegDecoder::decode(const PixelBufferBase& jpeg)
+{
+    int slot = slots.acquire();
+    if (slot == -1) {
+        // all slots are still queued for or held by the renderer
+        dropCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const PixelBufferBase& out = slots.at(slot);
+    int64_t begin = FrameSync::now();
+
+    if (!decodeInto(jpeg, out)) {
+        std::cerr << "camera " << out.getIndex() << ": bad jpeg frame" << std::endl;
+        slots.release(slot);
+        dropCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    int64_t end = FrameSync::now();
+    lastDecodeUs.store(end - begin, std::memory_order_relaxed);
+    totalDecodeUs.fetch_add(end - begin, std::memory_order_relaxed);
+    decodeCount.fetch_add(1, std::memory_order_relaxed);
+
+    auto frame = slots.wrap(slot);
+    frame->setTimestamp(jpeg.getTimestamp(), jpeg.getSequence());
+
+    if (sync.put(std::move(frame), end, set)) {
+        frames.putSet(set);
+        if (frames.markReady())
+            notify();
+    }
+}
+
+// nothing with a destructor may live here, an error longjmps out of libjpeg
+bool JpegDecoder::decodeInto(const PixelBufferBase& jpeg,
+                             const PixelBufferBase& out)
+{
+    if (setjmp(error.jump)) {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_mem_src(&cinfo, static_cast<unsigned char*>(jpeg.getStart()),
+                 jpeg.getLength());
+    jpeg_read_header(&cinfo, TRUE);
+    if (static_cast<int>(cinfo.image_width) != out.getWidth() ||
+        static_cast<int>(cinfo.image_height) != out.getHeight()) {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    // the byte order of XBGR32
+    cinfo.out_color_space = JCS_EXT_BGRX;
+    jpeg_start_decompress(&cinfo);
+
+    JSAMPLE* start = static_cast<JSAMPLE*>(out.getStart());
+    size_t stride = static_cast<size_t>(out.getWidth()) * 4;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW rows[4];
+        JDIMENSION num = 0;
+        // as many rows as libjpeg hands out at once, at most 4 for 4:2:0
+        while (num < 4 && cinfo.output_scanline + num < cinfo.output_height) {
+            rows[num] = start + (cinfo.output_scanline + num) * stride;
+            num++;
+        }
+        jpeg_read_scanlines(&cinfo, rows, num);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    return true;
+}
+
+void JpegDecoder::errorExit(j_common_ptr cinfo)
+{
+    ErrorManager* error = reinterpret_cast<ErrorManager*>(cinfo->err);
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(error->jump, 1);
+}
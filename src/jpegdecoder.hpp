@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <csetjmp>
+
+#include <jpeglib.h>
+
+#include "message.hpp"
+#include "slotpool.hpp"
+#include "framesync.hpp"
+#include "framechannel.hpp"
+
+/*
+ * decodes one camera's MJPEG frames on a thread of its own, libjpeg-turbo
+ * writes the scanlines straight into the camera's staging slots as XBGR32,
+ * there is no intermediate image. Decoded frames join the frame sets
+ * like those of uncompressed cameras, a slot is free again once the
+ * renderer released the frame.
+ */
+class JpegDecoder
+{
+public:
+    // slots are the camera's staging buffers, notify tells the renderer
+    // about new frames
+    JpegDecoder(const std::vector<PixelBufferBase>& slots_, FrameSync& sync_,
+                FrameChannel& frames_, std::function<void()> notify_);
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+    ~JpegDecoder();
+
+    // called from the capture thread, a frame still queued when a newer one
+    // arrives is dropped
+    void push(std::shared_ptr<PixelBufferBase>&& jpeg);
+    void start();
+    void stop();
+
+    uint64_t getDecodeCount() const
+    {
+        return decodeCount.load(std::memory_order_relaxed);
+    }
+    // of the last frame, and averaged over all frames
+    uint64_t getLastDecodeUs() const
+    {
+        return lastDecodeUs.load(std::memory_order_relaxed);
+    }
+    uint64_t getAvgDecodeUs() const
+    {
+        uint64_t count = getDecodeCount();
+        return count ? totalDecodeUs.load(std::memory_order_relaxed) / count : 0;
+    }
+    uint64_t getDropCount() const
+    {
+        return dropCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Decode
+    {
+        std::shared_ptr<PixelBufferBase> jpeg;
+        // a frame whose seq is not the last pushed has a newer one behind
+        uint64_t seq;
+    };
+
+    // libjpeg reports errors by calling error_exit, which must not return
+    struct ErrorManager
+    {
+        struct jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+
+    SlotPool slots;
+    FrameSync& sync;
+    FrameChannel& frames;
+    std::function<void()> notify;
+
+    // kept across frames, so are the buffers libjpeg allocates for it
+    struct jpeg_decompress_struct cinfo;
+    ErrorManager error;
+    std::vector<FrameSync::Frame> set;
+    messaging::Receiver incoming;
+    std::thread thread;
+
+    std::atomic<uint64_t> pushCount{0};
+    std::atomic<uint64_t> decodeCount{0};
+    std::atomic<uint64_t> lastDecodeUs{0};
+    std::atomic<uint64_t> totalDecodeUs{0};
+    std::atomic<uint64_t> dropCount{0};
+
+    void run();
+    void decode(const PixelBufferBase& jpeg);
+    // false for a broken frame or one of another size than out
+    bool decodeInto(const PixelBufferBase& jpeg, const PixelBufferBase& out);
+    static void errorExit(j_common_ptr cinfo);
+};
@@ -5,6 +5,9 @@
 #include <chrono>
 #include <thread>
 #include <map>
+#include <algorithm>
+#include <sstream>
+#include <future>
 
 #include <signal.h>
 #include <sys/epoll.h>
@@ -12,6 +15,8 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
 
 #include <opencv2/opencv.hpp>
 
@@ -19,14 +24,76 @@
 #include "v4l2capture.hpp"
 #include "replxx.hxx"
 #include "message.hpp"
+#include "framechannel.hpp"
+#include "framesync.hpp"
+#include "poller.hpp"
+#include "jpegdecoder.hpp"
+#include "framesource.hpp"
+#include "pacedsource.hpp"
+#include "replaysource.hpp"
+#include "session.hpp"
+#include "recorder.hpp"
+#include "framestage.hpp"
+#include "capturethread.hpp"
+#include "camerahealth.hpp"
+#include "fisheye.hpp"
 
 class RenderWorker
 {
 public:
 struct Commit {};
 
-    RenderWorker(Render& render_) :
-        render(render_)
+    // the camera's layer shows a placeholder until CameraRestored
+    struct CameraLost
+    {
+        int cam;
+    };
+
+    // exported buffers of a reopened camera, the fds are ours to close
+    struct DmaBufs
+    {
+        std::vector<PixelBufferBase> buffers;
+        std::vector<int> fds;
+
+        DmaBufs() = default;
+        DmaBufs(const DmaBufs&) = delete;
+        DmaBufs& operator=(const DmaBufs&) = delete;
+
+        ~DmaBufs()
+        {
+            for (int fd : fds) {
+                ::close(fd);
+            }
+        }
+    };
+
+    // dmaBufs is null unless the camera captures into exported buffers
+    struct CameraRestored
+    {
+        int cam;
+        std::shared_ptr<DmaBufs> dmaBufs;
+    };
+
+    struct SetView
+    {
+        Render::View view;
+    };
+
+    struct SetCompose
+    {
+        Render::Compose compose;
+    };
+
+    // the results of Render::benchCompose come back through done
+    struct Bench
+    {
+        int frames;
+        std::promise<std::vector<Render::BenchResult>> done;
+    };
+
+    RenderWorker(Render& render_, FrameChannel& frames_) :
+        render(render_),
+        frames(frames_)
     {}
 
     messaging::Sender getSender()
@@ -36,23 +103,71 @@ struct Commit {};
 
     void run()
     {
-        try {
-            for(;;) {
-                incoming.wait()
-                    .handle<std::shared_ptr<PixelBufferBase>>(
-                        [&](std::shared_ptr<PixelBufferBase>& pbuf)
-                        {
-                            render.updateTexture(pbuf);
-                        }
-                    )
-                    .handle<Commit>(
-                        [&](Commit&)
-                        {
+        bool closed = false;
+
+        while (!closed) {
+            incoming.wait(closed)
+                .handle<Commit>(
+                    [&](Commit&)
+                    {
+                        int taken = frames.takeAll(
+                            [&](std::shared_ptr<PixelBufferBase>& pbuf)
+                            {
+                                render.updateTexture(pbuf);
+                            });
+
+                        if (taken)
                             render.render(0);
+                    }
+                )
+                .handle<CameraLost>(
+                    [&](CameraLost& msg)
+                    {
+                        render.setCameraLost(msg.cam, true);
+                        render.render(0);
+                    }
+                )
+                .handle<CameraRestored>(
+                    [&](CameraRestored& msg)
+                    {
+                        // its new buffers, or the camera stays a placeholder
+                        if (msg.dmaBufs) {
+                            try {
+                                render.importDmaBuf(msg.cam, msg.dmaBufs->buffers,
+                                                    msg.dmaBufs->fds);
+                            } catch (const std::exception& e) {
+                                std::cerr << "camera " << msg.cam
+                                          << ": dma-buf import failed, "
+                                          << e.what() << std::endl;
+                                return;
+                            }
                         }
-                    );
-            }
-        } catch(messaging::CloseQueue&) {
+                        render.setCameraLost(msg.cam, false);
+                    }
+                )
+                .handle<SetView>(
+                    [&](SetView& msg)
+                    {
+                        render.setView(msg.view);
+                        render.render(0);
+                    }
+                )
+                .handle<SetCompose>(
+                    [&](SetCompose& msg)
+                    {
+                        render.setCompose(msg.compose);
+                    }
+                )
+                .handle<Bench>(
+                    [&](Bench& msg)
+                    {
+                        try {
+                            msg.done.set_value(render.benchCompose(msg.frames));
+                        } catch (...) {
+                            msg.done.set_exception(std::current_exception());
+                        }
+                    }
+                );
         }
     }
 
@@ -63,6 +178,7 @@ struct Commit {};
 
 private:
     Render& render;
+    FrameChannel& frames;
     messaging::Receiver incoming;
     void (RenderWorker::*state)();
 };
@@ -81,97 +197,92 @@ public:
         int num;
     };
 
-    CaptureWorker(std::vector<v4l2::Capture>& caps, enum v4l2::PixFormat pixFormat,
-                  const std::vector<std::vector<PixelBufferBase>>& bufBank,
-                  messaging::Sender render_) :
-        captures(caps),
-        render(render_)
+    // starts writing every camera's frames to recorder, null stops it
+    struct Record
+    {
+        std::shared_ptr<Recorder> recorder;
+    };
+
+    CaptureWorker(std::vector<std::unique_ptr<CameraHealth>>& cameras_,
+                  FrameSync& sync_, FrameStage& stage_,
+                  Poller::Backend backend_ = Poller::Backend::IoUring) :
+        cameras(cameras_),
+        sync(sync_),
+        stage(stage_),
+        set(cameras_.size()),
+        backend(backend_),
+        poller(createPoller(backend_)),
+        polledFds(cameras_.size(), -1),
+        ready(cameras_.size() + 1)
     {
-        for (size_t i = 0; i < captures.size(); i++) {
-            captures[i].open("/dev/video" + std::to_string(i), pixFormat, bufBank[i]);
-            captures[i].start();
+        for (auto& camera : cameras) {
+            camera->start(FrameSync::now());
         }
+
+        // one poll set for the whole life of the worker, control messages
+        // wake it through the queue's eventfd
+        poller->add(incoming.getEventFd(), controlEvent);
     }
 
-    void run()
+    const char* getPollerName() const
     {
-        try {
-            for (;;) {
-                incoming.wait()
-                    .handle<PreviewAll>(
-                        [&](const PreviewAll&)
-                        {
-                            epoll_fd = epoll_create1(0);
-
-                            for (size_t i = 0; i < captures.size(); i++) {
-                                struct epoll_event event = {};
-                                event.data.u32 = i;
-                                event.events = EPOLLIN; // do not use edge trigger
-                                int ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, captures[i].getFd(),
-                                        &event);
-                                if (ret == -1)
-                                    throw std::runtime_error("EPOLL_CTL_ADD error");
-                            }
-
-                            while (incoming.empty()) {
-                                std::vector<struct epoll_event> events(captures.size());
-                                int nevent = epoll_wait(epoll_fd, events.data(), events.size(), -1);
-                                if (nevent == -1) {
-                                    if (errno != EINTR)
-                                        throw std::runtime_error("epoll_wait error, erron: " + std::to_string(errno));
-                                }
-
-                                for (int i = 0; i < nevent; i++) {
-                                    int data = events[i].data.u32;
-                                    std::shared_ptr<PixelBufferBase> pb(captures[data].dequeBuffer());
-                                    render.send(pb);
-                                }
-                                render.send(RenderWorker::Commit());
-                            }
+        return poller->name();
+    }
 
-                            // do not stop, bug in kernel driver
-                            // for (auto& m : captures) {
-                                // m.stop();
-                            // }
-                            close(epoll_fd);
-                        }
-                    )
-                    .handle<PreviewOne>(
-                        [&](const PreviewOne& msg)
-                        {
-                            currentCapture = msg.num;
-                            epoll_fd = epoll_create1(0);
-                            {
-                                // captures[currentCapture].start();
-                                struct epoll_event event = {};
-                                event.data.u32 = currentCapture;
-                                event.events = EPOLLIN;
-                                int ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, captures[currentCapture].getFd(), &event);
-                                if (ret == -1)
-                                    throw std::runtime_error("EPOLL_CTL_ADD error");
-                            }
+    /*
+     * every camera is captured by a thread of its own from now on, this
+     * worker only handles control messages. Call it before run()
+     */
+    void startThreads(const std::vector<CaptureThread::Config>& configs)
+    {
+        for (size_t i = 0; i < cameras.size(); i++) {
+            threads.emplace_back(new CaptureThread(*cameras[i], stage,
+                                                   cameras.size(),
+                                                   configs.at(i), backend));
+            threads.back()->start();
+        }
+    }
 
-                            while (incoming.empty()) {
-                                struct epoll_event event;
-                                int nevent = epoll_wait(epoll_fd, &event, 1, -1);
-                                if (nevent == -1) {
-                                    if (errno != EINTR)
-                                        throw std::runtime_error("epoll_wait error, erron: " + std::to_string(errno));
-                                }
-
-                                int data = event.data.u32;
-                                std::shared_ptr<PixelBufferBase> pb(captures[data].dequeBuffer());
-                                render.send(pb);
-                                render.send(RenderWorker::Commit());
-                            }
+    void run()
+    {
+        bool closed = false;
+
+        while (!closed) {
+            incoming.wait(closed)
+                .handle<PreviewAll>(
+                    [&](const PreviewAll&)
+                    {
+                        previewAll = true;
+                        sync.setActive(cameras.size() == 32 ? ~0U :
+                                       (1U << cameras.size()) - 1);
+
+                        // do not stop, bug in kernel driver
+                        captureFrames();
+                    }
+                )
+                .handle<PreviewOne>(
+                    [&](const PreviewOne& msg)
+                    {
+                        previewAll = false;
+                        currentCapture = msg.num;
+                        sync.setActive(1U << currentCapture);
+
+                        captureFrames();
+                    }
+                )
+                .handle<Record>(
+                    [&](Record& msg)
+                    {
+                        stage.setRecorder(std::move(msg.recorder));
+
+                        if (capturing)
+                            captureFrames();
+                    }
+                );
+        }
 
-                            // do not stop, bug in kernel driver
-                            // captures[currentCapture].stop();
-                            close(epoll_fd);
-                        }
-                    );
-            }
-        } catch (messaging::CloseQueue&) {
+        for (auto& thread : threads) {
+            thread->stop();
         }
     }
 
@@ -186,14 +297,126 @@ public:
     }
 
 private:
-    std::vector<v4l2::Capture>& captures;
-    int epoll_fd;
+    static const uint32_t controlEvent = UINT32_MAX;
+
+    std::vector<std::unique_ptr<CameraHealth>>& cameras;
+    FrameSync& sync;
+    FrameStage& stage;
+    std::vector<FrameSync::Frame> set;
     int currentCapture = 0;
+    bool previewAll = false;
+    bool capturing = false;
+    Poller::Backend backend;
+    std::unique_ptr<Poller> poller;
+    // the fd each camera is polled with, -1 for none
+    std::vector<int> polledFds;
+    std::vector<uint32_t> ready;
+    std::vector<std::unique_ptr<CaptureThread>> threads;
 
     messaging::Receiver incoming;
-    messaging::Sender render;
     messaging::Sender calibrator;
     void (CaptureWorker::*state)();
+
+    // the recorder wants every camera, whichever is shown. A lost camera
+    // is polled again once it is back
+    void updatePolling()
+    {
+        for (size_t i = 0; i < cameras.size(); i++) {
+            setPolled(i, !cameras[i]->isLost() &&
+                         (previewAll || stage.isRecording() ||
+                          static_cast<int>(i) == currentCapture));
+        }
+    }
+
+    void setPolled(size_t cam, bool on)
+    {
+        if ((polledFds[cam] != -1) == on)
+            return;
+
+        if (on) {
+            polledFds[cam] = cameras[cam]->getSource().getFd();
+            poller->add(polledFds[cam], cam);
+            cameras[cam]->watch(FrameSync::now());
+        } else {
+            poller->remove(polledFds[cam], cam);
+            polledFds[cam] = -1;
+            cameras[cam]->unwatch();
+        }
+    }
+
+    /*
+     * stalled or failed cameras stop being polled before they are reopened,
+     * which closes their fd
+     */
+    void checkCameras()
+    {
+        int64_t now = FrameSync::now();
+        bool back = false;
+
+        for (size_t i = 0; i < cameras.size(); i++) {
+            cameras[i]->checkStall(now);
+            if (!cameras[i]->isLost())
+                continue;
+
+            setPolled(i, false);
+            back |= cameras[i]->retry(now);
+        }
+        if (back)
+            updatePolling();
+    }
+
+    int camerasTimeoutMs() const
+    {
+        int64_t now = FrameSync::now();
+        int timeout = -1;
+
+        for (const auto& camera : cameras) {
+            timeout = CameraHealth::earliest(timeout, camera->timeoutMs(now));
+        }
+
+        return timeout;
+    }
+
+    /*
+     * hands frame sets to the renderer until a control message is pending,
+     * the wait is bounded by the deadline of a set being filled. Capture
+     * threads run on their own, they are only told which cameras to poll.
+     */
+    void captureFrames()
+    {
+        capturing = true;
+        if (!threads.empty()) {
+            for (size_t i = 0; i < threads.size(); i++) {
+                threads[i]->setPolled(previewAll || stage.isRecording() ||
+                                      static_cast<int>(i) == currentCapture);
+            }
+            return;
+        }
+
+        updatePolling();
+        while (incoming.armWakeup()) {
+            int timeout = CameraHealth::earliest(stage.timeoutMs(),
+                                                 camerasTimeoutMs());
+            int nevent = poller->wait(ready.data(), ready.size(), timeout);
+
+            for (int i = 0; i < nevent; i++) {
+                uint32_t data = ready[i];
+                if (data == controlEvent) {
+                    incoming.clearWakeup();
+                    continue;
+                }
+                if (cameras[data]->isLost())
+                    continue;
+
+                std::shared_ptr<PixelBufferBase> pb(
+                        cameras[data]->dequeue(FrameSync::now()));
+                if (pb)
+                    stage.put(std::move(pb), set);
+            }
+            checkCameras();
+            stage.flushExpired(set);
+        }
+    }
 };
 
 #if 0
@@ -265,6 +488,580 @@ private:
 };
 #endif
 
+static Render::InputFormat toInputFormat(enum v4l2::PixFormat pixelFmt)
+{
+    switch (pixelFmt) {
+    case v4l2::PixFormat::YUYV:
+        return Render::InputFormat::YUYV;
+    case v4l2::PixFormat::NV12:
+        return Render::InputFormat::NV12;
+    case v4l2::PixFormat::SRGGB10:
+    case v4l2::PixFormat::SGRBG10:
+    case v4l2::PixFormat::SGBRG10:
+    case v4l2::PixFormat::SBGGR10:
+        return Render::InputFormat::Bayer10;
+    case v4l2::PixFormat::SRGGB12:
+    case v4l2::PixFormat::SGRBG12:
+    case v4l2::PixFormat::SGBRG12:
+    case v4l2::PixFormat::SBGGR12:
+        return Render::InputFormat::Bayer12;
+    case v4l2::PixFormat::MJPEG:
+        // decoded to XBGR32 on the cpu
+    case v4l2::PixFormat::XBGR32:
+    default:
+        return Render::InputFormat::XBGR32;
+    }
+}
+
+static Render::CfaPattern toCfaPattern(enum v4l2::PixFormat pixelFmt)
+{
+    switch (pixelFmt) {
+    case v4l2::PixFormat::SGRBG10:
+    case v4l2::PixFormat::SGRBG12:
+        return Render::CfaPattern::GRBG;
+    case v4l2::PixFormat::SGBRG10:
+    case v4l2::PixFormat::SGBRG12:
+        return Render::CfaPattern::GBRG;
+    case v4l2::PixFormat::SBGGR10:
+    case v4l2::PixFormat::SBGGR12:
+        return Render::CfaPattern::BGGR;
+    default:
+        return Render::CfaPattern::RGGB;
+    }
+}
+
+enum class SourceType { V4L2, Pattern, Image, Session };
+
+struct Options
+{
+    SourceType source = SourceType::V4L2;
+    std::string imagePath = "resource/src_1.jpg";
+    std::string sessionPath;
+    // of the synthetic sources, cameras run at their own rate
+    double fps = 30;
+    // of session replay relative to the recording, 0 as fast as possible
+    double speed = 1;
+    int cameraNum = 4;
+    // of the sensor, frames are the crop's size when there is one
+    int width = 1280;
+    int height = 800;
+    v4l2::Rect crop;
+    // fisheye intrinsics of the cameras, no lens correction without
+    std::string calibrationPath;
+    double balance = 0;
+    // cells per side of the warp mesh, 0 corrects every pixel
+    int mesh = 0;
+    Render::View view = Render::View::Grid;
+    Render::Compose compose = Render::Compose::Raster;
+    Render::ComposeGroup composeGroup;
+    // frames per composition path of the benchmark, which then quits
+    int benchFrames = 0;
+    // frames of one set lie within the skew, an incomplete set is shown
+    // anyway after the deadline. 0 derives them from the frame rate, the
+    // deadline is then one frame period
+    int64_t syncSkewUs = 0;
+    int64_t syncDeadlineUs = 0;
+    enum v4l2::PixFormat pixelFmt = v4l2::PixFormat::XBGR32;
+    // levels and white balance of bayer formats, the pattern follows the
+    // format
+    Render::BayerParams bayer;
+    Poller::Backend poller = Poller::Backend::IoUring;
+    // a capture thread per camera, cpus are handed out round robin
+    bool threaded = false;
+    std::vector<int> cpus;
+    int priority = 0;
+};
+
+static const std::map<std::string, enum v4l2::PixFormat> pixFormatNames = {
+    {"xbgr32", v4l2::PixFormat::XBGR32},
+    {"yuyv", v4l2::PixFormat::YUYV},
+    {"nv12", v4l2::PixFormat::NV12},
+    {"srggb10", v4l2::PixFormat::SRGGB10},
+    {"sgrbg10", v4l2::PixFormat::SGRBG10},
+    {"sgbrg10", v4l2::PixFormat::SGBRG10},
+    {"sbggr10", v4l2::PixFormat::SBGGR10},
+    {"srggb12", v4l2::PixFormat::SRGGB12},
+    {"sgrbg12", v4l2::PixFormat::SGRBG12},
+    {"sgbrg12", v4l2::PixFormat::SGBRG12},
+    {"sbggr12", v4l2::PixFormat::SBGGR12},
+    {"mjpeg", v4l2::PixFormat::MJPEG},
+};
+
+static const std::map<std::string, Render::View> viewNames = {
+    {"grid", Render::View::Grid},
+    {"strip", Render::View::Strip},
+    {"surround", Render::View::Surround},
+};
+
+static const std::map<std::string, Render::Compose> composeNames = {
+    {"raster", Render::Compose::Raster},
+    {"compute", Render::Compose::Compute},
+    {"async", Render::Compose::AsyncCompute},
+};
+
+/*
+ * gpu time avg/max and wall time per frame of each path, and the compute
+ * workgroup that came out fastest
+ */
+static void printBench(const std::vector<Render::BenchResult>& results)
+{
+    const Render::BenchResult* fastest = nullptr;
+
+    for (const auto& result : results) {
+        std::string name;
+        for (const auto& compose : composeNames) {
+            if (compose.second == result.compose)
+                name = compose.first;
+        }
+        if (result.compose != Render::Compose::Raster)
+            name += " " + std::to_string(result.group.width) + "x" +
+                    std::to_string(result.group.height);
+
+        std::cout << name << ": " << result.frames << " frames, gpu "
+                  << result.avgUs << "/" << result.maxUs << " us, "
+                  << result.frameUs << " us per frame\n";
+
+        if (result.compose == Render::Compose::Compute && result.avgUs &&
+            (!fastest || result.avgUs < fastest->avgUs))
+            fastest = &result;
+    }
+
+    if (fastest)
+        std::cout << "fastest workgroup: " << fastest->group.width << "x"
+                  << fastest->group.height << std::endl;
+}
+
+static void printUsage(const char* name)
+{
+    std::cout
+        << "usage: " << name << " [options]\n"
+        << "  -s, --source <type>    v4l2, pattern, image or session (v4l2)\n"
+        << "  -i, --image <path>     image of the image source (resource/src_1.jpg)\n"
+        << "  -r, --session <path>   recorded session, implies --source session\n"
+        << "  -f, --fps <n>          frame rate of pattern and image sources (30)\n"
+        << "  -x, --speed <n>        session replay speed, 0 as fast as possible (1)\n"
+        << "  -c, --cameras <n>      number of cameras (4)\n"
+        << "  -W, --width <n>        frame width of the sensor (1280)\n"
+        << "  -H, --height <n>       frame height of the sensor (800)\n"
+        << "  -R, --crop <geometry>  capture only <w>x<h>+<x>+<y> of the sensor\n"
+        << "  -F, --format <name>    xbgr32, yuyv, nv12, s<cfa>10, s<cfa>12 or mjpeg\n"
+        << "  -l, --black-level <n>  raw black level of bayer formats (0)\n"
+        << "  -L, --white-level <n>  raw white level, 0 the largest of the bit depth (0)\n"
+        << "  -g, --gains <r,g,b>    white balance of bayer formats (1,1,1)\n"
+        << "  -k, --calibration <path>  fisheye intrinsics, corrects the lenses\n"
+        << "  -b, --balance <n>      0 crops to valid pixels, 1 keeps all of them (0)\n"
+        << "  -m, --mesh <n>         correct the lenses at n x n cells per camera\n"
+        << "  -v, --view <name>      grid, strip or surround (grid)\n"
+        << "  -o, --compose <name>   surround view by raster, compute or async (raster)\n"
+        << "  -w, --workgroup <w>x<h>  tile of the compute composition (8x8)\n"
+        << "  -B, --bench <n>        time every composition path over n frames, then quit\n"
+        << "  -S, --sync-skew <us>   largest spread of the frames of one set (8000)\n"
+        << "  -D, --sync-deadline <us>  show an incomplete set after this (1/fps)\n"
+        << "  -p, --poller <name>    io_uring or epoll (io_uring)\n"
+        << "  -t, --threads          capture each camera on a thread of its own\n"
+        << "  -C, --cpus <list>      comma separated cpus of the capture threads\n"
+        << "  -P, --priority <n>     SCHED_FIFO priority of the capture threads\n"
+        << "  -h, --help\n";
+}
+
+// false when the program should exit, usage has then been printed
+static bool parseOptions(int argc, char* argv[], Options& opt)
+{
+    static const struct option longOptions[] = {
+        {"source", required_argument, nullptr, 's'},
+        {"image", required_argument, nullptr, 'i'},
+        {"session", required_argument, nullptr, 'r'},
+        {"fps", required_argument, nullptr, 'f'},
+        {"speed", required_argument, nullptr, 'x'},
+        {"cameras", required_argument, nullptr, 'c'},
+        {"width", required_argument, nullptr, 'W'},
+        {"height", required_argument, nullptr, 'H'},
+        {"crop", required_argument, nullptr, 'R'},
+        {"format", required_argument, nullptr, 'F'},
+        {"black-level", required_argument, nullptr, 'l'},
+        {"white-level", required_argument, nullptr, 'L'},
+        {"gains", required_argument, nullptr, 'g'},
+        {"calibration", required_argument, nullptr, 'k'},
+        {"balance", required_argument, nullptr, 'b'},
+        {"mesh", required_argument, nullptr, 'm'},
+        {"view", required_argument, nullptr, 'v'},
+        {"compose", required_argument, nullptr, 'o'},
+        {"workgroup", required_argument, nullptr, 'w'},
+        {"bench", required_argument, nullptr, 'B'},
+        {"sync-skew", required_argument, nullptr, 'S'},
+        {"sync-deadline", required_argument, nullptr, 'D'},
+        {"poller", required_argument, nullptr, 'p'},
+        {"threads", no_argument, nullptr, 't'},
+        {"cpus", required_argument, nullptr, 'C'},
+        {"priority", required_argument, nullptr, 'P'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    try {
+        int c;
+        while ((c = getopt_long(argc, argv, "s:i:r:f:x:c:W:H:R:F:l:L:g:k:b:m:v:o:w:B:S:D:p:tC:P:h",
+                                longOptions, nullptr)) != -1) {
+            std::string arg(optarg ? optarg : "");
+
+            switch (c) {
+            case 's':
+                if (arg == "v4l2")
+                    opt.source = SourceType::V4L2;
+                else if (arg == "pattern")
+                    opt.source = SourceType::Pattern;
+                else if (arg == "image")
+                    opt.source = SourceType::Image;
+                else if (arg == "session")
+                    opt.source = SourceType::Session;
+                else
+                    throw std::invalid_argument("source");
+                break;
+            case 'i':
+                opt.imagePath = arg;
+                break;
+            case 'r':
+                opt.sessionPath = arg;
+                opt.source = SourceType::Session;
+                break;
+            case 'f':
+                opt.fps = std::stod(arg);
+                break;
+            case 'x':
+                opt.speed = std::stod(arg);
+                break;
+            case 'c':
+                opt.cameraNum = std::stoi(arg);
+                break;
+            case 'W':
+                opt.width = std::stoi(arg);
+                break;
+            case 'H':
+                opt.height = std::stoi(arg);
+                break;
+            case 'R': {
+                v4l2::Rect& crop = opt.crop;
+                char end;
+                if (sscanf(arg.c_str(), "%dx%d+%d+%d%c", &crop.width,
+                           &crop.height, &crop.left, &crop.top, &end) != 4)
+                    throw std::invalid_argument("crop");
+                break;
+            }
+            case 'F':
+                opt.pixelFmt = pixFormatNames.at(arg);
+                break;
+            case 'l':
+                opt.bayer.blackLevel = std::stof(arg);
+                break;
+            case 'L':
+                opt.bayer.whiteLevel = std::stof(arg);
+                break;
+            case 'g': {
+                Render::BayerParams& bayer = opt.bayer;
+                char end;
+                if (sscanf(arg.c_str(), "%f,%f,%f%c", &bayer.gainR,
+                           &bayer.gainG, &bayer.gainB, &end) != 3)
+                    throw std::invalid_argument("gains");
+                break;
+            }
+            case 'k':
+                opt.calibrationPath = arg;
+                break;
+            case 'b':
+                opt.balance = std::stod(arg);
+                break;
+            case 'm':
+                opt.mesh = std::stoi(arg);
+                break;
+            case 'v':
+                opt.view = viewNames.at(arg);
+                break;
+            case 'o':
+                opt.compose = composeNames.at(arg);
+                break;
+            case 'w': {
+                Render::ComposeGroup& group = opt.composeGroup;
+                char end;
+                if (sscanf(arg.c_str(), "%ux%u%c", &group.width, &group.height,
+                           &end) != 2)
+                    throw std::invalid_argument("workgroup");
+                break;
+            }
+            case 'B':
+                opt.benchFrames = std::stoi(arg);
+                break;
+            case 'S':
+                opt.syncSkewUs = std::stoll(arg);
+                break;
+            case 'D':
+                opt.syncDeadlineUs = std::stoll(arg);
+                break;
+            case 'p':
+                if (arg == "io_uring")
+                    opt.poller = Poller::Backend::IoUring;
+                else if (arg == "epoll")
+                    opt.poller = Poller::Backend::Epoll;
+                else
+                    throw std::invalid_argument("poller");
+                break;
+            case 't':
+                opt.threaded = true;
+                break;
+            case 'C': {
+                std::stringstream list(arg);
+                std::string cpu;
+                opt.cpus.clear();
+                while (std::getline(list, cpu, ',')) {
+                    opt.cpus.push_back(std::stoi(cpu));
+                }
+                break;
+            }
+            case 'P':
+                opt.priority = std::stoi(arg);
+                break;
+            default:
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "invalid argument: " << argv[optind - 1] << std::endl;
+        printUsage(argv[0]);
+        return false;
+    }
+
+    if (opt.source == SourceType::Session && opt.sessionPath.empty()) {
+        std::cerr << "session source needs --session" << std::endl;
+        return false;
+    }
+    if (opt.mesh < 0 || opt.mesh > 255) {
+        std::cerr << "the mesh has 1 to 255 cells per side, or 0 to "
+                  << "correct every pixel" << std::endl;
+        return false;
+    }
+    for (int cpu : opt.cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            std::cerr << "cpus must be 0 to " << CPU_SETSIZE - 1 << std::endl;
+            return false;
+        }
+    }
+    if (opt.priority < 0 || opt.priority > sched_get_priority_max(SCHED_FIFO)) {
+        std::cerr << "invalid SCHED_FIFO priority" << std::endl;
+        return false;
+    }
+    if (opt.fps <= 0 || opt.speed < 0 || opt.cameraNum < 1 || opt.cameraNum > 32 ||
+        opt.width <= 0 || opt.height <= 0 || opt.balance < 0 || opt.balance > 1) {
+        std::cerr << "invalid frame rate, speed, camera count, frame size or "
+                  << "balance" << std::endl;
+        return false;
+    }
+    if (opt.benchFrames < 0 || !opt.composeGroup.width ||
+        !opt.composeGroup.height) {
+        std::cerr << "invalid benchmark frame count or workgroup" << std::endl;
+        return false;
+    }
+    // a set waits for its late frames at most a frame period, longer and
+    // the next set's frames arrive before it is shown
+    if (!opt.syncDeadlineUs)
+        opt.syncDeadlineUs = static_cast<int64_t>(1000000 / opt.fps);
+    if (!opt.syncSkewUs)
+        opt.syncSkewUs = std::min<int64_t>(8000, opt.syncDeadlineUs / 2);
+    if (opt.syncSkewUs <= 0 || opt.syncSkewUs >= opt.syncDeadlineUs) {
+        std::cerr << "the sync skew must be positive and below the deadline"
+                  << std::endl;
+        return false;
+    }
+    const Render::BayerParams& bayer = opt.bayer;
+    if (bayer.blackLevel < 0 || bayer.whiteLevel < 0 ||
+        (bayer.whiteLevel > 0 && bayer.whiteLevel <= bayer.blackLevel) ||
+        bayer.gainR <= 0 || bayer.gainG <= 0 || bayer.gainB <= 0) {
+        std::cerr << "invalid black or white level or gains" << std::endl;
+        return false;
+    }
+    // even offsets keep the chroma and bayer pattern phase of the sensor
+    const v4l2::Rect& crop = opt.crop;
+    if (crop.width || crop.height) {
+        if (opt.source != SourceType::V4L2) {
+            std::cerr << "--crop applies to v4l2 cameras only" << std::endl;
+            return false;
+        }
+        if (crop.width <= 0 || crop.height <= 0 || crop.left < 0 ||
+            crop.top < 0 || crop.left + crop.width > opt.width ||
+            crop.top + crop.height > opt.height ||
+            (crop.left | crop.top | crop.width | crop.height) & 1) {
+            std::cerr << "crop must be even and lie within the frame size"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * prefer letting the cameras write into exported dma-bufs the gpu imports,
+ * fall back to the renderer's staging memory when either side lacks it
+ */
+static void openCaptures(std::vector<std::unique_ptr<FrameSource>>& sources,
+                         Render& render, enum v4l2::PixFormat pixelFmt,
+                         int imgWidth, int imgHeight, const v4l2::Rect& crop,
+                         int qBufNum)
+{
+    std::vector<std::vector<PixelBufferBase>> bufBank = render.getBufferBank();
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::string path("/dev/video" + std::to_string(i));
+        v4l2::Capture* capture = new v4l2::Capture;
+        sources[i].reset(capture);
+        capture->setCrop(crop);
+
+        // decoded into the staging buffers by a JpegDecoder
+        if (pixelFmt == v4l2::PixFormat::MJPEG) {
+            try {
+                capture->openCompressed(path, pixelFmt, imgWidth, imgHeight,
+                                        qBufNum, i);
+            } catch (const std::exception& e) {
+                std::cout << path << ": " << e.what() << ", waiting for it"
+                          << std::endl;
+                capture->close();
+            }
+            continue;
+        }
+
+        if (render.supportsDmaBufImport()) {
+            try {
+                std::vector<PixelBufferBase> buffers =
+                    capture->openExported(path, pixelFmt, imgWidth,
+                                          imgHeight, qBufNum, i);
+                render.importDmaBuf(i, buffers, capture->getDmaBufFds());
+                std::cout << path << ": dma-buf capture" << std::endl;
+                continue;
+            } catch (const std::exception& e) {
+                std::cout << path << ": dma-buf unavailable, " << e.what()
+                          << std::endl;
+                capture->close();
+            }
+        }
+
+        // a camera missing at startup is waited for like a lost one
+        try {
+            capture->open(path, pixelFmt, bufBank[i]);
+        } catch (const std::exception& e) {
+            std::cout << path << ": " << e.what() << ", waiting for it"
+                      << std::endl;
+            capture->close();
+        }
+    }
+}
+
+/*
+ * frames are views of the mapped session when the renderer can upload from
+ * it, copies in its staging buffers otherwise
+ */
+static void openReplay(std::vector<std::unique_ptr<FrameSource>>& sources,
+                       Render& render, const Options& opt,
+                       std::shared_ptr<session::Reader> recording)
+{
+    std::vector<std::vector<PixelBufferBase>> bufBank = render.getBufferBank();
+    std::vector<ReplaySource*> replays;
+    std::vector<std::vector<PixelBufferBase>> views;
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        ReplaySource* replay = new ReplaySource(bufBank[i], recording, i,
+                                                opt.speed);
+        sources[i].reset(replay);
+        replays.push_back(replay);
+        views.push_back(replay->getFrameViews());
+    }
+
+    if (!render.supportsHostImport())
+        return;
+
+    try {
+        render.importHostMemory(recording->getData(), recording->getSize(),
+                                views);
+        for (auto replay : replays) {
+            replay->setZeroCopy(true);
+        }
+        std::cout << opt.sessionPath << ": zero-copy replay" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << opt.sessionPath << ": can not upload from the mapping, "
+                  << e.what() << std::endl;
+    }
+}
+
+// the synthetic sources write into the renderer's staging buffers
+static void openSources(std::vector<std::unique_ptr<FrameSource>>& sources,
+                        Render& render, const Options& opt, int qBufNum,
+                        std::shared_ptr<session::Reader> recording)
+{
+    if (opt.source == SourceType::V4L2) {
+        // the crop is all that is captured, staged and uploaded
+        const v4l2::Rect& crop = opt.crop;
+        openCaptures(sources, render, opt.pixelFmt,
+                     crop.width ? crop.width : opt.width,
+                     crop.width ? crop.height : opt.height, crop, qBufNum);
+        return;
+    }
+    if (opt.source == SourceType::Session) {
+        openReplay(sources, render, opt, recording);
+        return;
+    }
+
+    std::vector<std::vector<PixelBufferBase>> bufBank = render.getBufferBank();
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        switch (opt.source) {
+        case SourceType::Pattern:
+            sources[i] = createPatternSource(bufBank[i], opt.fps, opt.pixelFmt);
+            break;
+        case SourceType::Image:
+            sources[i] = createImageSource(bufBank[i], opt.fps, opt.pixelFmt,
+                                           opt.imagePath);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/*
+ * the corrected view of a camera is the size of its sensor, the tables map
+ * it into the captured frame, which may be a crop of the sensor
+ */
+static void setLensCorrection(Render& render, const Options& opt,
+                              int cameraNum, int imgWidth, int imgHeight)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<fisheye::Intrinsics> intrinsics =
+        fisheye::loadCalibration(opt.calibrationPath, cameraNum);
+    cv::Size sensor(opt.width, opt.height);
+    cv::Rect frame(opt.crop.left, opt.crop.top, imgWidth, imgHeight);
+
+    std::vector<std::vector<float>> tables;
+    for (int i = 0; i < cameraNum; i++) {
+        tables.push_back(fisheye::buildRemapTable(intrinsics[i], sensor, frame,
+                                                  sensor, opt.balance));
+    }
+    render.setRemapTables(sensor.width, sensor.height, std::move(tables));
+
+    fisheye::Surround surround =
+        fisheye::loadSurround(opt.calibrationPath, cameraNum);
+    if (!surround.size.empty()) {
+        std::vector<float> samples, blend;
+        fisheye::buildSurroundTable(intrinsics, surround, sensor, frame,
+                                    samples, blend);
+        render.setSurroundTable(surround.size.width, surround.size.height,
+                                std::move(samples), std::move(blend));
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    std::cout << opt.calibrationPath << ": lens tables built in " << ms
+              << " ms" << std::endl;
+}
+
 // namespace menu
 // {
 
@@ -281,27 +1078,153 @@ private:
 
 // }
 
-int main()
+int main(int argc, char* argv[])
 {
-    int cameraNum = 4;
-    int qBufNum = 4;
-    int imgWidth = 1280;
-    int imgHeight = 800;
-    enum v4l2::PixFormat pixelFmt = v4l2::PixFormat::XBGR32;
-    int pixelSize = pixelFmt == v4l2::PixFormat::XBGR32 ? 4 : 4;
-    int imgSize = imgHeight * imgWidth * pixelSize;
+    Options opt;
+    if (!parseOptions(argc, argv, opt))
+        return -1;
+
+    /*
+     * a camera's buffers: what the display path may hold at once
+     * (FrameSync's pending frame, FrameChannel's and the renderer's uploads
+     * of its two frames in flight), the writes a recording may have
+     * pending, and one that stays queued with the driver however slow the
+     * disk is
+     */
+    const int displayHold = 4;
+    const int recordPending = 2;
+    int qBufNum = displayHold + recordPending + 1;
+    // a camera delivering nothing for this long is reopened
+    int64_t cameraStallUs = 1000000;
 
     // signal(SIGINT, [](int){ keepRunning = false; });
-    std::vector<v4l2::Capture> captures(cameraNum);
+    // outlive the renderer, which may hold their frames until the end
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    std::vector<std::unique_ptr<JpegDecoder>> decoders;
 
     try {
+        std::shared_ptr<session::Reader> recording;
+        if (opt.source == SourceType::Session) {
+            // the recording decides what the cameras deliver
+            recording = std::make_shared<session::Reader>(opt.sessionPath);
+            const session::FileHeader& header = recording->getHeader();
+            opt.pixelFmt = static_cast<enum v4l2::PixFormat>(header.pixelFormat);
+            opt.width = header.width;
+            opt.height = header.height;
+            opt.cameraNum = header.cameraNum;
+        }
+        if (opt.source != SourceType::V4L2 &&
+            opt.pixelFmt == v4l2::PixFormat::MJPEG) {
+            throw std::runtime_error("synthetic sources produce raw frames only");
+        }
 
-        Render render(imgWidth, imgHeight, pixelSize, cameraNum, qBufNum);
+        int cameraNum = opt.cameraNum;
+        int imgWidth = opt.crop.width ? opt.crop.width : opt.width;
+        int imgHeight = opt.crop.width ? opt.crop.height : opt.height;
+        enum v4l2::PixFormat pixelFmt = opt.pixelFmt;
+        sources.resize(cameraNum);
+
+        Render render(imgWidth, imgHeight, toInputFormat(pixelFmt), cameraNum,
+                      qBufNum);
+        render.setStagingMode(Render::StagingMode::HostImport);
+        if (opt.crop.width) {
+            render.setSensorCrop(opt.width, opt.height, opt.crop.left,
+                                 opt.crop.top);
+        }
+        if (!opt.calibrationPath.empty())
+            setLensCorrection(render, opt, cameraNum, imgWidth, imgHeight);
+        if (opt.mesh)
+            render.setWarpMesh(opt.mesh);
+        if (opt.view == Render::View::Surround && !render.hasSurround())
+            throw std::runtime_error("the calibration has no surround view");
+        render.setView(opt.view);
+        Render::BayerParams bayer = opt.bayer;
+        bayer.pattern = toCfaPattern(pixelFmt);
+        render.setBayerParams(bayer);
+        render.setComposeGroup(opt.composeGroup);
         render.init();
-        std::vector<std::vector<PixelBufferBase>> bufBank = render.getBufferBank();
+        if (opt.benchFrames && !render.hasSurround())
+            throw std::runtime_error("the benchmark composes the surround view "
+                                     "of a calibration");
+        if (opt.compose == Render::Compose::AsyncCompute &&
+            !render.supportsAsyncCompose()) {
+            std::cerr << "no compute only queue, composing on the graphics queue"
+                      << std::endl;
+            opt.compose = Render::Compose::Compute;
+        }
+        if (opt.compose == Render::Compose::Compute &&
+            !render.supportsComputeCompose()) {
+            std::cerr << "compute composition is not supported, rasterizing"
+                      << std::endl;
+            opt.compose = Render::Compose::Raster;
+        }
+        render.setCompose(opt.compose);
+        openSources(sources, render, opt, qBufNum, recording);
+
+        FrameChannel frames(cameraNum);
+        FrameSync sync(cameraNum, opt.syncSkewUs, opt.syncDeadlineUs);
+        RenderWorker renderWorker(render, frames);
+        messaging::Sender renderQueue(renderWorker.getSender());
+        auto notifyRender =
+            [renderQueue]() mutable
+            {
+                renderQueue.send(RenderWorker::Commit());
+            };
+        FrameStage frameStage(sync, frames, notifyRender);
 
-        RenderWorker renderWorker(render);
-        CaptureWorker capWorker(captures, pixelFmt, bufBank, renderWorker.getSender());
+        // a lost camera leaves the frame sets and shows a placeholder, a
+        // reopened one may capture into new exported buffers
+        auto cameraChanged =
+            [&sync, &sources, renderQueue](int cam, bool lost) mutable
+            {
+                sync.setLost(cam, lost);
+                if (lost) {
+                    renderQueue.send(RenderWorker::CameraLost{cam});
+                    return;
+                }
+
+                std::shared_ptr<RenderWorker::DmaBufs> dmaBufs;
+                auto capture = dynamic_cast<v4l2::Capture*>(sources[cam].get());
+                if (capture && !capture->getDmaBufFds().empty()) {
+                    dmaBufs = std::make_shared<RenderWorker::DmaBufs>();
+                    dmaBufs->buffers = capture->getBuffers();
+                    for (int fd : capture->getDmaBufFds()) {
+                        dmaBufs->fds.push_back(dup(fd));
+                    }
+                }
+                renderQueue.send(RenderWorker::CameraRestored{cam, dmaBufs});
+            };
+        std::vector<std::unique_ptr<CameraHealth>> cameras;
+        for (int i = 0; i < cameraNum; i++) {
+            cameras.emplace_back(new CameraHealth(
+                    *sources[i], i,
+                    opt.source == SourceType::V4L2 ? cameraStallUs : 0,
+                    cameraChanged));
+        }
+
+        if (pixelFmt == v4l2::PixFormat::MJPEG) {
+            std::vector<std::vector<PixelBufferBase>> bufBank = render.getBufferBank();
+
+            for (int i = 0; i < cameraNum; i++) {
+                decoders.emplace_back(new JpegDecoder(bufBank[i], sync, frames,
+                                                      notifyRender));
+                decoders.back()->start();
+                frameStage.setDecoder(i, decoders.back().get());
+            }
+        }
+
+        CaptureWorker capWorker(cameras, sync, frameStage, opt.poller);
+        if (opt.threaded) {
+            std::vector<CaptureThread::Config> configs(cameraNum);
+            for (int i = 0; i < cameraNum; i++) {
+                if (!opt.cpus.empty())
+                    configs[i].cpu = opt.cpus[i % opt.cpus.size()];
+                configs[i].priority = opt.priority;
+            }
+            capWorker.startThreads(configs);
+            std::cout << "capture threads: one per camera" << std::endl;
+        }
+        std::cout << "capture poller: " << capWorker.getPollerName() << std::endl;
 
         // cmdline interface
         using namespace std::placeholders;
@@ -339,7 +1262,38 @@ int main()
         capQueue.send(CaptureWorker::PreviewAll());
         // capQueue.send(CaptureWorker::PreviewOne(0));
 
-        std::string help1(std::string("input number: 0 to ") + std::to_string(captures.size() - 1) + " to select device");
+        // shared with the capture thread, which may drop it last
+        std::shared_ptr<Recorder> recorder;
+        auto stopRecording =
+            [&]()
+            {
+                capQueue.send(CaptureWorker::Record());
+                recorder->stop();
+                std::cout << recorder->getPath() << ": "
+                          << recorder->getFrameCount() << " frames, "
+                          << recorder->getBytesWritten() / (1024 * 1024) << " MiB, "
+                          << recorder->getDropCount() << " dropped"
+                          << (recorder->failed() ? ", failed" : "")
+                          << std::endl;
+                recorder.reset();
+            };
+
+        auto runBench =
+            [&](int frames)
+            {
+                RenderWorker::Bench bench{frames, {}};
+                auto results = bench.done.get_future();
+                renderQueue.send(std::move(bench));
+                try {
+                    printBench(results.get());
+                } catch (const std::exception& e) {
+                    std::cerr << "benchmark failed: " << e.what() << std::endl;
+                }
+            };
+        if (opt.benchFrames)
+            runBench(opt.benchFrames);
+
+        std::string help1(std::string("input number: 0 to ") + std::to_string(sources.size() - 1) + " to select device");
 
         std::string help2(std::string("Input:\n") +
                           "\t\'b\': back");
@@ -356,7 +1310,7 @@ int main()
                 try {
                     num = std::stoi(input);
 
-                    if (num >= captures.size()) {
+                    if (num < 0 || num >= static_cast<int>(sources.size())) {
                         throw(num);
                     }
 
@@ -381,7 +1335,8 @@ int main()
             };
         stage = &f1;
 
-        for (;;) {
+        // the benchmark from the command line runs without the repl
+        while (!opt.benchFrames) {
             char const* cinput{ nullptr };
 
             std::cout << *phelp << std::endl;
@@ -418,6 +1373,12 @@ int main()
                     << ".exit\n\texit the repl\n"
                     << ".clear\n\tclears the screen\n"
                     << ".history\n\tdisplays the history output\n"
+                    << ".stats\n\tdisplays per camera frame statistics\n"
+                    << ".record <path>\n\trecords all cameras to a session file\n"
+                    << ".stop\n\tstops recording\n"
+                    << ".view <name>\n\tshows the cameras as a grid, a strip or a surround view\n"
+                    << ".compose <name>\n\tcomposes the surround view by raster, compute or async\n"
+                    << ".bench [frames]\n\ttimes every composition path and compute workgroup (300 frames)\n"
                     << ".prompt <str>\n\tset the repl prompt to <str>\n";
 
                 rx.history_add(input);
@@ -444,6 +1405,144 @@ int main()
                 rx.history_add(input);
                 continue;
 
+            } else if (input.compare(0, 6, ".stats") == 0) {
+                // frames lost at the source or replaced before the renderer
+                // took them, frame handles that missed the preallocated
+                // pool, how far each camera lagged within the last set,
+                // last/avg/max time from capture to dequeue, and how often
+                // it failed and came back
+                std::cout << "frame sets: " << sync.getCompleteCount()
+                          << " complete, " << sync.getExpiredCount()
+                          << " expired\n";
+                for (int i = 0; i < cameraNum; i++) {
+                    std::cout << "camera " << i
+                              << ": lost " << sources[i]->getDropCount()
+                              << ", dropped " << frames.getDropCount(i)
+                              << ", heap allocs " << sources[i]->getHeapAllocCount()
+                              << ", skew " << sync.getSkewUs(i) << " us"
+                              << ", wakeup " << frameStage.getLastWakeUs(i)
+                              << "/" << frameStage.getAvgWakeUs(i)
+                              << "/" << frameStage.getMaxWakeUs(i) << " us"
+                              << ", failures " << cameras[i]->getLostCount()
+                              << ", reconnects " << cameras[i]->getReconnectCount()
+                              << (cameras[i]->isLost() ? ", missing" : "")
+                              << "\n";
+                }
+                for (size_t i = 0; i < decoders.size(); i++) {
+                    std::cout << "decoder " << i
+                              << ": " << decoders[i]->getDecodeCount() << " frames"
+                              << ", last " << decoders[i]->getLastDecodeUs() << " us"
+                              << ", avg " << decoders[i]->getAvgDecodeUs() << " us"
+                              << ", dropped " << decoders[i]->getDropCount()
+                              << "\n";
+                }
+                // gpu time of the surround view by either path, to compare
+                // them switch with .compose
+                for (const auto& compose : composeNames) {
+                    if (!render.getAvgComposeUs(compose.second))
+                        continue;
+                    std::cout << compose.first << " composition: "
+                              << render.getLastComposeUs(compose.second)
+                              << "/" << render.getAvgComposeUs(compose.second)
+                              << "/" << render.getMaxComposeUs(compose.second)
+                              << " us\n";
+                }
+                if (recorder) {
+                    std::cout << "recording " << recorder->getPath()
+                              << ": " << recorder->getFrameCount() << " frames"
+                              << ", last write " << recorder->getLastWriteUs() << " us"
+                              << ", dropped " << recorder->getDropCount()
+                              << "\n";
+                }
+
+                rx.history_add(input);
+                continue;
+
+            } else if (input.compare(0, 7, ".record") == 0) {
+                auto pos = input.find(" ");
+                if (pos == std::string::npos) {
+                    std::cout << "Error: '.record' missing argument\n";
+                } else if (recorder) {
+                    std::cout << "Error: already recording to "
+                              << recorder->getPath() << "\n";
+                } else {
+                    try {
+                        // beyond that a camera's frames are not recorded,
+                        // the rest of its buffers keep capture going
+                        recorder = std::make_shared<Recorder>(
+                                input.substr(pos + 1), pixelFmt, imgWidth,
+                                imgHeight, cameraNum, recordPending);
+                        recorder->start();
+                        capQueue.send(CaptureWorker::Record{recorder});
+                    } catch (const std::exception& e) {
+                        std::cout << "Error: " << e.what() << "\n";
+                        recorder.reset();
+                    }
+                }
+
+                rx.history_add(input);
+                continue;
+
+            } else if (input.compare(0, 5, ".stop") == 0) {
+                if (recorder)
+                    stopRecording();
+                else
+                    std::cout << "Error: not recording\n";
+
+                rx.history_add(input);
+                continue;
+
+            } else if (input.compare(0, 5, ".view") == 0) {
+                auto pos = input.find(" ");
+                auto view = pos == std::string::npos ? viewNames.end() :
+                    viewNames.find(input.substr(pos + 1));
+                if (view == viewNames.end())
+                    std::cout << "Error: '.view' takes grid, strip or surround\n";
+                else if (view->second == Render::View::Surround &&
+                         !render.hasSurround())
+                    std::cout << "Error: the calibration has no surround view\n";
+                else
+                    renderQueue.send(RenderWorker::SetView{view->second});
+
+                rx.history_add(input);
+                continue;
+
+            } else if (input.compare(0, 8, ".compose") == 0) {
+                auto pos = input.find(" ");
+                auto compose = pos == std::string::npos ? composeNames.end() :
+                    composeNames.find(input.substr(pos + 1));
+                if (compose == composeNames.end())
+                    std::cout << "Error: '.compose' takes raster, compute or async\n";
+                else if (compose->second == Render::Compose::Compute &&
+                         !render.supportsComputeCompose())
+                    std::cout << "Error: compute composition is not supported\n";
+                else if (compose->second == Render::Compose::AsyncCompute &&
+                         !render.supportsAsyncCompose())
+                    std::cout << "Error: there is no compute only queue\n";
+                else
+                    renderQueue.send(RenderWorker::SetCompose{compose->second});
+
+                rx.history_add(input);
+                continue;
+
+            } else if (input.compare(0, 6, ".bench") == 0) {
+                auto pos = input.find(" ");
+                int frames = 0;
+                try {
+                    frames = pos == std::string::npos ? 300 :
+                             std::stoi(input.substr(pos + 1));
+                } catch (const std::exception&) {
+                }
+                if (frames <= 0)
+                    std::cout << "Error: '.bench' takes a frame count\n";
+                else if (!render.hasSurround())
+                    std::cout << "Error: the calibration has no surround view\n";
+                else
+                    runBench(frames);
+
+                rx.history_add(input);
+                continue;
+
             } else if (input.compare(0, 6, ".clear") == 0) {
                 // clear the screen
                 rx.clear_screen();
@@ -461,9 +1560,14 @@ int main()
             }
         }
 
+        if (recorder)
+            stopRecording();
         capWorker.done();
-        renderWorker.done();
         captureThread.join();
+        for (auto& decoder : decoders) {
+            decoder->stop();
+        }
+        renderWorker.done();
         renderThread.join();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
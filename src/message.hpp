@@ -1,9 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
 #include <memory>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
 
 /*
  * refer to C++ Concurrency in Action, 2nd Edition appedix C
@@ -12,38 +24,292 @@
 
 namespace messaging
 {
+    /*
+     * one object per message type, its address identifies the type so
+     * dispatch is a pointer compare instead of a dynamic_cast
+     */
+    template<typename Msg>
+    struct TypeTag
+    {
+        static const char id;
+    };
+
+    template<typename Msg>
+    const char TypeTag<Msg>::id = 0;
+
     struct MessageBase
     {
+        explicit MessageBase(const void* type_) :
+            type(type_)
+        {}
+
         virtual ~MessageBase() {}
+
+        const void* const type;
     };
 
     template<typename Msg>
     struct WrappedMessage : public MessageBase
     {
         Msg contents;
-        WrappedMessage(const Msg& contents_) :
-            contents(contents_)
+        template<typename M>
+        explicit WrappedMessage(M&& contents_) :
+            MessageBase(&TypeTag<Msg>::id),
+            contents(std::forward<M>(contents_))
         {}
     };
 
+    /*
+     * bounded multi-producer single-consumer ring, after Dmitry Vyukov's
+     * bounded queue: every slot carries a sequence number telling whether it
+     * is free for the lap a producer is on or published for the reader.
+     * Messages are constructed in place in the slot and dispatched from
+     * there, so passing one does not touch the heap.
+     * The reader sleeps on an eventfd that producers only write while it
+     * is actually waiting, a producer finding the ring full sleeps until
+     * the reader frees a slot.
+     */
     class Queue
     {
+    public:
+        static const size_t slotSize = 64;
+
+        explicit Queue(size_t capacity_ = 256) :
+            capacity(roundUpPow2(capacity_)),
+            mask(capacity - 1),
+            slots(new Slot[capacity])
+        {
+            for (size_t i = 0; i < capacity; i++) {
+                slots[i].seq.store(i, std::memory_order_relaxed);
+            }
+
+            efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (efd == -1) {
+                throw std::runtime_error("failed to create queue eventfd");
+            }
+        }
+
+        ~Queue()
+        {
+            while (!empty()) {
+                release(head++);
+            }
+            ::close(efd);
+        }
+
+        Queue(const Queue&) = delete;
+        Queue& operator=(const Queue&) = delete;
+
+        template<typename T>
+        void push(T&& msg)
+        {
+            using Msg = typename std::decay<T>::type;
+            static_assert(sizeof(WrappedMessage<Msg>) <= slotSize &&
+                          alignof(WrappedMessage<Msg>) <= alignof(std::max_align_t),
+                          "message does not fit a queue slot");
+
+            size_t pos = tail.load(std::memory_order_relaxed);
+            for (;;) {
+                Slot& slot = slots[pos & mask];
+                size_t seq = slot.seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) -
+                                static_cast<intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                        slot.msg = ::new (static_cast<void*>(slot.storage))
+                            WrappedMessage<Msg>(std::forward<T>(msg));
+                        slot.seq.store(pos + 1, std::memory_order_release);
+                        break;
+                    }
+                } else if (diff < 0) {
+                    waitNotFull(pos);
+                    pos = tail.load(std::memory_order_relaxed);
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            // pairs with the fence in armWakeup, either the reader sees the
+            // message or we see it waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting.exchange(false, std::memory_order_relaxed)) {
+                uint64_t one = 1;
+                ssize_t ret = ::write(efd, &one, sizeof(one));
+                (void)ret;
+            }
+        }
+
+        /*
+         * waits for the next message and hands it to f where it lies. The
+         * reader moves past it first, so within f empty() and armWakeup()
+         * only see the messages behind it. The slot is given back to the
+         * producers once f returns or throws
+         */
+        template<typename Func>
+        bool waitAndConsume(Func&& f)
+        {
+            MessageBase* msg = waitFront();
+
+            struct Releaser
+            {
+                Queue* q;
+                size_t pos;
+                ~Releaser() { q->release(pos); }
+            } releaser{this, head++};
+
+            return f(msg);
+        }
+
+        // reader side only
+        bool empty() const
+        {
+            return slots[head & mask].seq.load(std::memory_order_acquire) !=
+                   head + 1;
+        }
+
+        /*
+         * for a reader that polls the eventfd along with other fds: false
+         * if messages are pending already, otherwise the eventfd becomes
+         * readable with the next push
+         */
+        bool armWakeup()
+        {
+            waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!empty()) {
+                waiting.store(false, std::memory_order_relaxed);
+                return false;
+            }
+
+            return true;
+        }
+
+        // consumes a wakeup reported on the eventfd
+        void clearWakeup()
+        {
+            uint64_t cnt;
+            ssize_t ret = ::read(efd, &cnt, sizeof(cnt));
+            (void)ret;
+        }
+
+        int getEventFd() const
+        {
+            return efd;
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> seq;
+            MessageBase* msg = nullptr;
+            alignas(std::max_align_t) unsigned char storage[slotSize];
+        };
+
+        const size_t capacity;
+        const size_t mask;
+        std::unique_ptr<Slot[]> slots;
+        int efd = -1;
+
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<bool> waiting{false};
+        alignas(64) std::atomic<int> fullWaiters{0};
+        std::mutex fullMutex;
+        std::condition_variable notFull;
+        alignas(64) size_t head = 0;
+
+        MessageBase* waitFront()
+        {
+            for (;;) {
+                if (!empty())
+                    return slots[head & mask].msg;
+
+                if (!armWakeup())
+                    return slots[head & mask].msg;
+
+                struct pollfd pfd = {};
+                pfd.fd = efd;
+                pfd.events = POLLIN;
+                ::poll(&pfd, 1, -1);
+
+                clearWakeup();
+            }
+        }
+
+        // until the slot at pos is free for this lap, or taken by another
+        // producer
+        void waitNotFull(size_t pos)
+        {
+            Slot& slot = slots[pos & mask];
+            std::unique_lock<std::mutex> lock(fullMutex);
+
+            fullWaiters.fetch_add(1, std::memory_order_relaxed);
+            // pairs with the fence in release, either the reader sees us
+            // waiting or we see the slot it freed
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            notFull.wait(lock, [&]() {
+                size_t seq = slot.seq.load(std::memory_order_acquire);
+                return static_cast<intptr_t>(seq) -
+                       static_cast<intptr_t>(pos) >= 0;
+            });
+            fullWaiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // the slot of the message at pos, which the reader has moved past
+        void release(size_t pos)
+        {
+            Slot& slot = slots[pos & mask];
+
+            slot.msg->~MessageBase();
+            slot.msg = nullptr;
+            slot.seq.store(pos + capacity, std::memory_order_release);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (fullWaiters.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(fullMutex);
+                notFull.notify_all();
+            }
+        }
+
+        static size_t roundUpPow2(size_t n)
+        {
+            size_t p = 2;
+            while (p < n)
+                p <<= 1;
+            return p;
+        }
+    };
+
+    /*
+     * the queue the ring replaced, a std::queue under a mutex with a heap
+     * allocation and a notify_all per message. Kept to measure the ring
+     * against, see bench/queue_bench.cpp
+     */
+    class MutexQueue
+    {
     public:
         template<typename T>
-        void push(const T& msg)
+        void push(T&& msg)
         {
+            using Msg = typename std::decay<T>::type;
             std::lock_guard<std::mutex> lk(m);
-            q.push(std::make_shared<WrappedMessage<T>>(msg));
+            q.push(std::make_shared<WrappedMessage<Msg>>(std::forward<T>(msg)));
             c.notify_all();
         }
 
-        std::shared_ptr<MessageBase> waitAndPop()
+        template<typename Func>
+        bool waitAndConsume(Func&& f)
         {
-            std::unique_lock<std::mutex> lk(m);
-            c.wait(lk, [&]{ return !q.empty(); });
-            auto res = q.front();
-            q.pop();
-            return res;
+            std::shared_ptr<MessageBase> msg;
+            {
+                std::unique_lock<std::mutex> lk(m);
+                c.wait(lk, [&]{ return !q.empty(); });
+                msg = q.front();
+                q.pop();
+            }
+
+            return f(msg.get());
         }
 
         bool empty() const
@@ -109,11 +375,10 @@ namespace messaging
         template<typename Dispatcher,typename OtherMsg,typename OtherFunc>
         friend class TemplateDispatcher;
 
-        bool dispatch(std::shared_ptr<MessageBase> const& msg)
+        bool dispatch(MessageBase* msg)
         {
-            if (WrappedMessage<Msg>* wrapper =
-                dynamic_cast<WrappedMessage<Msg>*>(msg.get())) {
-                f(wrapper->contents);
+            if (msg->type == &TypeTag<Msg>::id) {
+                f(static_cast<WrappedMessage<Msg>*>(msg)->contents);
                 return true;
             } else {
                 return prev->dispatch(msg);
@@ -122,26 +387,30 @@ namespace messaging
 
         void waitAndDispatch()
         {
-            for (;;) {
-                auto msg = q->waitAndPop();
-                if (dispatch(msg))
-                    break;
+            while (!q->waitAndConsume(
+                        [this](MessageBase* msg) { return dispatch(msg); })) {
             }
         }
     };
 
+    /*
+     * a CloseQueue message is thrown as an exception, unless the dispatcher
+     * was given a flag to raise instead
+     */
     class Dispatcher
     {
     public:
         Dispatcher(Dispatcher&& other) :
             q(other.q),
+            closed(other.closed),
             chained(other.chained)
         {
             other.chained = true;
         }
 
-        explicit Dispatcher(Queue* q_) :
+        explicit Dispatcher(Queue* q_, bool* closed_ = nullptr) :
             q(q_),
+            closed(closed_),
             chained(false)
         {}
 
@@ -161,6 +430,7 @@ namespace messaging
 
     private:
         Queue *q;
+        bool *closed;
         bool chained;
 
         Dispatcher(Dispatcher const&) = delete;
@@ -169,10 +439,14 @@ namespace messaging
         template<typename Disp, typename Msg, typename Func>
         friend class TemplateDispatcher;
 
-        bool dispatch(std::shared_ptr<MessageBase> const& msg)
+        bool dispatch(MessageBase* msg)
         {
-            if (dynamic_cast<WrappedMessage<CloseQueue>*>(msg.get())) {
-                throw CloseQueue();
+            if (msg->type == &TypeTag<CloseQueue>::id) {
+                if (!closed)
+                    throw CloseQueue();
+
+                *closed = true;
+                return true;
             }
 
             return false;
@@ -180,9 +454,8 @@ namespace messaging
 
         void waitAndDispatch()
         {
-            for (;;) {
-                auto msg = q->waitAndPop();
-                dispatch(msg);
+            while (!q->waitAndConsume(
+                        [this](MessageBase* msg) { return dispatch(msg); })) {
             }
         }
     };
@@ -199,10 +472,10 @@ namespace messaging
         {}
 
         template<typename Msg>
-        void send(const Msg& msg)
+        void send(Msg&& msg)
         {
             if(q) {
-                q->push(msg);
+                q->push(std::forward<Msg>(msg));
             }
         }
 
@@ -223,11 +496,32 @@ namespace messaging
             return Dispatcher(&q);
         }
 
+        // sets closed on CloseQueue instead of throwing it
+        Dispatcher wait(bool& closed)
+        {
+            return Dispatcher(&q, &closed);
+        }
+
         bool empty() const
         {
             return q.empty();
         }
 
+        int getEventFd() const
+        {
+            return q.getEventFd();
+        }
+
+        bool armWakeup()
+        {
+            return q.armWakeup();
+        }
+
+        void clearWakeup()
+        {
+            q.clearWakeup();
+        }
+
     private:
         Queue q;
     };
@@ -253,6 +547,15 @@ public:
     int getHeight() const { return height; }
     int getIndex() const { return index; }
     int getSubIndex() const { return subIndex; }
+    // capture time in microseconds, CLOCK_MONOTONIC
+    int64_t getTimestamp() const { return timestamp; }
+    uint32_t getSequence() const { return sequence; }
+
+    void setTimestamp(int64_t timestamp_, uint32_t sequence_)
+    {
+        timestamp = timestamp_;
+        sequence = sequence_;
+    }
 
     virtual ~PixelBufferBase()
     {}
@@ -264,5 +567,7 @@ protected:
     int height = 0;
     int index = 0;
     int subIndex = 0;
+    int64_t timestamp = 0;
+    uint32_t sequence = 0;
 };
 
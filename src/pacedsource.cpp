@@ -0,0 +1,271 @@
+#include "pacedsource.hpp"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// BT.601 limited range, as the fragment shader expects it
+static void bgrToYuv(const cv::Vec3b& bgr, int& y, int& u, int& v)
+{
+    int b = bgr[0];
+    int g = bgr[1];
+    int r = bgr[2];
+
+    y = (66 * r + 129 * g + 25 * b + 128) / 256 + 16;
+    u = (-38 * r - 74 * g + 112 * b + 128) / 256 + 128;
+    v = (112 * r - 94 * g - 18 * b + 128) / 256 + 128;
+}
+
+/*
+ * the whole frame, laid out as a camera delivers it in pixFormat. Bayer
+ * keeps the one channel its cfa position samples, scaled to the bit depth.
+ */
+static std::vector<unsigned char> convertFrame(const cv::Mat& bgr,
+                                               enum v4l2::PixFormat pixFormat)
+{
+    int width = bgr.cols;
+    int height = bgr.rows;
+    std::vector<unsigned char> frame(v4l2::frameSize(pixFormat, width, height));
+
+    switch (pixFormat) {
+    case v4l2::PixFormat::XBGR32: {
+        cv::Mat xbgr(height, width, CV_8UC4, frame.data());
+        cv::cvtColor(bgr, xbgr, cv::COLOR_BGR2BGRA);
+        break;
+    }
+    case v4l2::PixFormat::YUYV:
+        for (int row = 0; row < height; row++) {
+            unsigned char* out = frame.data() + row * width * 2;
+            for (int col = 0; col + 1 < width; col += 2) {
+                int y0, u0, v0, y1, u1, v1;
+                bgrToYuv(bgr.at<cv::Vec3b>(row, col), y0, u0, v0);
+                bgrToYuv(bgr.at<cv::Vec3b>(row, col + 1), y1, u1, v1);
+                out[col * 2] = y0;
+                out[col * 2 + 1] = (u0 + u1) / 2;
+                out[col * 2 + 2] = y1;
+                out[col * 2 + 3] = (v0 + v1) / 2;
+            }
+        }
+        break;
+    case v4l2::PixFormat::NV12: {
+        unsigned char* chroma = frame.data() + width * height;
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+                int y, u, v;
+                bgrToYuv(bgr.at<cv::Vec3b>(row, col), y, u, v);
+                frame[row * width + col] = y;
+                // top left sample of each 2x2 block
+                if (!(row & 1) && !(col & 1)) {
+                    chroma[row / 2 * width + col] = u;
+                    chroma[row / 2 * width + col + 1] = v;
+                }
+            }
+        }
+        break;
+    }
+    case v4l2::PixFormat::MJPEG:
+        throw std::runtime_error("synthetic sources produce raw frames only");
+    default: {
+        // red at (redRow, redCol) of each 2x2 cell, blue diagonal to it
+        uint32_t fourcc = static_cast<uint32_t>(pixFormat);
+        bool bits12 = fourcc == V4L2_PIX_FMT_SRGGB12 ||
+                      fourcc == V4L2_PIX_FMT_SGRBG12 ||
+                      fourcc == V4L2_PIX_FMT_SGBRG12 ||
+                      fourcc == V4L2_PIX_FMT_SBGGR12;
+        int redRow = fourcc == V4L2_PIX_FMT_SGBRG10 || fourcc == V4L2_PIX_FMT_SGBRG12 ||
+                     fourcc == V4L2_PIX_FMT_SBGGR10 || fourcc == V4L2_PIX_FMT_SBGGR12;
+        int redCol = fourcc == V4L2_PIX_FMT_SGRBG10 || fourcc == V4L2_PIX_FMT_SGRBG12 ||
+                     fourcc == V4L2_PIX_FMT_SBGGR10 || fourcc == V4L2_PIX_FMT_SBGGR12;
+        int maxValue = bits12 ? 4095 : 1023;
+
+        uint16_t* out = reinterpret_cast<uint16_t*>(frame.data());
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+                const cv::Vec3b& px = bgr.at<cv::Vec3b>(row, col);
+                int channel = 1;
+                if ((row & 1) == redRow && (col & 1) == redCol)
+                    channel = 2;
+                else if ((row & 1) != redRow && (col & 1) != redCol)
+                    channel = 0;
+                out[row * width + col] = px[channel] * maxValue / 255;
+            }
+        }
+        break;
+    }
+    }
+
+    return frame;
+}
+
+// the last rows of a plane moved to its top
+static void copyScrolled(unsigned char* dst, const unsigned char* src,
+                         size_t lineSize, int rows, int shift)
+{
+    size_t tail = static_cast<size_t>(shift) * lineSize;
+    size_t head = static_cast<size_t>(rows - shift) * lineSize;
+
+    std::memcpy(dst, src + head, tail);
+    std::memcpy(dst + tail, src, head);
+}
+
+PacedSource::PacedSource(const std::vector<PixelBufferBase>& slots, double fps) :
+    m_slots(slots),
+    m_fps(fps)
+{
+    if (slots.empty() || fps <= 0) {
+        throw std::runtime_error("invalid initialization params");
+    }
+
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timerFd == -1) {
+        throw std::runtime_error("timerfd_create failed");
+    }
+}
+
+PacedSource::~PacedSource()
+{
+    ::close(m_timerFd);
+}
+
+void PacedSource::start()
+{
+    long interval = static_cast<long>(1e9 / m_fps);
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = interval / 1000000000;
+    spec.it_interval.tv_nsec = interval % 1000000000;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(m_timerFd, 0, &spec, nullptr)) {
+        throw std::runtime_error("timerfd_settime failed");
+    }
+}
+
+void PacedSource::stop()
+{
+    struct itimerspec spec = {};
+    timerfd_settime(m_timerFd, 0, &spec, nullptr);
+}
+
+std::shared_ptr<PixelBufferBase> PacedSource::dequeBuffer()
+{
+    uint64_t ticks = 0;
+    if (read(m_timerFd, &ticks, sizeof(ticks)) != sizeof(ticks))
+        return nullptr;
+
+    // ticks missed while the capture loop was busy are frames lost
+    m_dropCount.fetch_add(ticks - 1, std::memory_order_relaxed);
+    m_sequence += ticks - 1;
+
+    int slot = m_slots.acquire();
+    if (slot == -1) {
+        m_dropCount.fetch_add(1, std::memory_order_relaxed);
+        m_sequence++;
+        return nullptr;
+    }
+
+    uint32_t sequence = m_sequence++;
+    try {
+        fill(m_slots.at(slot), sequence);
+    } catch (...) {
+        m_slots.release(slot);
+        throw;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    auto frame = m_slots.wrap(slot);
+    frame->setTimestamp(ts.tv_sec * 1000000LL + ts.tv_nsec / 1000, sequence);
+
+    return frame;
+}
+
+StillSource::StillSource(const std::vector<PixelBufferBase>& slots, double fps,
+                         enum v4l2::PixFormat pixFormat, const cv::Mat& bgr,
+                         bool scroll) :
+    PacedSource(slots, fps),
+    m_pixFormat(pixFormat),
+    m_width(slots.at(0).getWidth()),
+    m_height(slots.at(0).getHeight()),
+    m_scroll(scroll)
+{
+    cv::Mat scaled;
+    cv::resize(bgr, scaled, cv::Size(m_width, m_height));
+    m_frame = convertFrame(scaled, pixFormat);
+
+    if (m_frame.size() > slots[0].getLength()) {
+        throw std::runtime_error("frame does not fit the buffers");
+    }
+}
+
+void StillSource::fill(const PixelBufferBase& slot, uint32_t sequence)
+{
+    unsigned char* dst = static_cast<unsigned char*>(slot.getStart());
+
+    if (!m_scroll) {
+        std::memcpy(dst, m_frame.data(), m_frame.size());
+        return;
+    }
+
+    // even, so bayer cells and nv12 chroma rows stay aligned
+    int shift = sequence * 2 % m_height & ~1;
+    if (m_pixFormat == v4l2::PixFormat::NV12) {
+        size_t lumaSize = static_cast<size_t>(m_width) * m_height;
+        copyScrolled(dst, m_frame.data(), m_width, m_height, shift);
+        copyScrolled(dst + lumaSize, m_frame.data() + lumaSize, m_width,
+                     m_height / 2, shift / 2);
+    } else {
+        copyScrolled(dst, m_frame.data(),
+                     v4l2::bytesPerLine(m_pixFormat, m_width), m_height, shift);
+    }
+}
+
+std::unique_ptr<FrameSource> createPatternSource(
+        const std::vector<PixelBufferBase>& slots, double fps,
+        enum v4l2::PixFormat pixFormat)
+{
+    int width = slots.at(0).getWidth();
+    int height = slots.at(0).getHeight();
+    cv::Mat bgr(height, width, CV_8UC3);
+
+    static const cv::Scalar bars[] = {
+        {255, 255, 255}, {0, 255, 255}, {255, 255, 0}, {0, 255, 0},
+        {255, 0, 255}, {0, 0, 255}, {255, 0, 0}, {0, 0, 0},
+    };
+    const int barNum = sizeof(bars) / sizeof(bars[0]);
+    for (int i = 0; i < barNum; i++) {
+        cv::rectangle(bgr, cv::Point(width * i / barNum, 0),
+                      cv::Point(width * (i + 1) / barNum, height),
+                      bars[i], cv::FILLED);
+    }
+    for (int x = 0; x < width; x += 64) {
+        cv::line(bgr, cv::Point(x, 0), cv::Point(x, height), {128, 128, 128});
+    }
+    for (int y = 0; y < height; y += 64) {
+        cv::line(bgr, cv::Point(0, y), cv::Point(width, y), {128, 128, 128});
+    }
+    cv::putText(bgr, "cam " + std::to_string(slots[0].getIndex()),
+                cv::Point(width / 8, height / 2), cv::FONT_HERSHEY_SIMPLEX,
+                height / 160.0, {0, 0, 0}, height / 80 + 1);
+
+    return std::unique_ptr<FrameSource>(
+            new StillSource(slots, fps, pixFormat, bgr, true));
+}
+
+std::unique_ptr<FrameSource> createImageSource(
+        const std::vector<PixelBufferBase>& slots, double fps,
+        enum v4l2::PixFormat pixFormat, const std::string& path)
+{
+    cv::Mat bgr = cv::imread(path, cv::IMREAD_COLOR);
+    if (bgr.empty()) {
+        throw std::runtime_error("failed to read image: " + path);
+    }
+
+    return std::unique_ptr<FrameSource>(
+            new StillSource(slots, fps, pixFormat, bgr, false));
+}
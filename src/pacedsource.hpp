@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+#include "message.hpp"
+#include "slotpool.hpp"
+#include "framesource.hpp"
+#include "v4l2capture.hpp"
+
+/*
+ * produces frames on a timer instead of a camera, written into the
+ * renderer's staging slots. A tick that finds every slot in use is dropped,
+ * as a camera drops a frame nobody dequeued in time.
+ */
+class PacedSource : public FrameSource
+{
+public:
+    PacedSource(const std::vector<PixelBufferBase>& slots, double fps);
+    PacedSource(const PacedSource&) = delete;
+    PacedSource& operator=(const PacedSource&) = delete;
+    ~PacedSource();
+
+    void start() override;
+    void stop() override;
+    // the timerfd, readable once per frame interval
+    int getFd() const override { return m_timerFd; }
+    std::shared_ptr<PixelBufferBase> dequeBuffer() override;
+    uint64_t getHeapAllocCount() const override
+    {
+        return m_slots.getHeapAllocCount();
+    }
+    uint64_t getDropCount() const override
+    {
+        return m_dropCount.load(std::memory_order_relaxed);
+    }
+
+protected:
+    // writes frame number sequence into slot
+    virtual void fill(const PixelBufferBase& slot, uint32_t sequence) = 0;
+
+private:
+    SlotPool m_slots;
+    int m_timerFd = -1;
+    double m_fps;
+    uint32_t m_sequence = 0;
+    std::atomic<uint64_t> m_dropCount{0};
+};
+
+/*
+ * a picture converted once to the capture format, copied into every frame.
+ * With scroll set it moves down two lines a frame, so tearing and stale
+ * frames show on screen.
+ */
+class StillSource : public PacedSource
+{
+public:
+    StillSource(const std::vector<PixelBufferBase>& slots, double fps,
+                enum v4l2::PixFormat pixFormat, const cv::Mat& bgr, bool scroll);
+
+protected:
+    void fill(const PixelBufferBase& slot, uint32_t sequence) override;
+
+private:
+    std::vector<unsigned char> m_frame;
+    enum v4l2::PixFormat m_pixFormat;
+    int m_width;
+    int m_height;
+    bool m_scroll;
+};
+
+// color bars and a grid, labeled with the camera index
+std::unique_ptr<FrameSource> createPatternSource(
+        const std::vector<PixelBufferBase>& slots, double fps,
+        enum v4l2::PixFormat pixFormat);
+// the image scaled to the frame size
+std::unique_ptr<FrameSource> createImageSource(
+        const std::vector<PixelBufferBase>& slots, double fps,
+        enum v4l2::PixFormat pixFormat, const std::string& path);
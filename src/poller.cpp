@@ -0,0 +1,356 @@
+#include "poller.hpp"
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/poll.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+namespace {
+class EpollPoller : public Poller
+{
+public:
+    EpollPoller()
+    {
+        fd = epoll_create1(EPOLL_CLOEXEC);
+        if (fd == -1)
+            throw std::runtime_error("epoll_create1 error, errno: " + std::to_string(errno));
+    }
+
+    ~EpollPoller() override
+    {
+        close(fd);
+    }
+
+    void add(int pfd, uint32_t data) override
+    {
+        struct epoll_event event = {};
+        event.data.u32 = data;
+        event.events = EPOLLIN; // do not use edge trigger
+        if (epoll_ctl(fd, EPOLL_CTL_ADD, pfd, &event) == -1)
+            throw std::runtime_error("EPOLL_CTL_ADD error, errno: " + std::to_string(errno));
+
+        events.resize(events.size() + 1);
+    }
+
+    void remove(int pfd, uint32_t) override
+    {
+        if (epoll_ctl(fd, EPOLL_CTL_DEL, pfd, nullptr) == -1)
+            throw std::runtime_error("EPOLL_CTL_DEL error, errno: " + std::to_string(errno));
+    }
+
+    int wait(uint32_t* ready, int maxReady, int timeoutMs) override
+    {
+        int num = std::min<int>(maxReady, events.size());
+        int nevent = epoll_wait(fd, events.data(), num, timeoutMs);
+        if (nevent == -1) {
+            if (errno != EINTR)
+                throw std::runtime_error("epoll_wait error, errno: " + std::to_string(errno));
+            return 0;
+        }
+
+        for (int i = 0; i < nevent; i++) {
+            ready[i] = events[i].data.u32;
+        }
+
+        return nevent;
+    }
+
+    const char* name() const override
+    {
+        return "epoll";
+    }
+
+private:
+    int fd = -1;
+    std::vector<struct epoll_event> events;
+};
+
+/*
+ * one-shot IORING_OP_POLL_ADD per fd, re-armed in the same io_uring_enter
+ * that waits for the next completions. A whole set of cameras costs one
+ * syscall to wait on instead of epoll_wait, and adding or removing fds is
+ * queued rather than a syscall of its own.
+ */
+class UringPoller : public Poller
+{
+public:
+    UringPoller()
+    {
+        struct io_uring_params p = {};
+        fd = syscall(__NR_io_uring_setup, ringEntries, &p);
+        if (fd < 0)
+            throw std::runtime_error("io_uring_setup error, errno: " + std::to_string(errno));
+
+        // IORING_OP_TIMEOUT and stable submissions came along with this
+        if (!(p.features & IORING_FEAT_NODROP)) {
+            close(fd);
+            throw std::runtime_error("io_uring is too old");
+        }
+
+        sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sqSize = cqSize = std::max(sqSize, cqSize);
+
+        sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqPtr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("io_uring sq ring mmap error");
+        }
+
+        cqPtr = single ? sqPtr :
+            mmap(nullptr, cqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqesPtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (cqPtr == MAP_FAILED || sqesPtr == MAP_FAILED) {
+            if (cqPtr != MAP_FAILED && !single)
+                munmap(cqPtr, cqSize);
+            if (sqesPtr != MAP_FAILED)
+                munmap(sqesPtr, sqesSize);
+            munmap(sqPtr, sqSize);
+            close(fd);
+            throw std::runtime_error("io_uring mmap error");
+        }
+
+        auto sq = static_cast<unsigned char*>(sqPtr);
+        sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sqEntries = p.sq_entries;
+        sqes = static_cast<struct io_uring_sqe*>(sqesPtr);
+
+        auto cq = static_cast<unsigned char*>(cqPtr);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    }
+
+    ~UringPoller() override
+    {
+        munmap(sqes, sqesSize);
+        if (cqPtr != sqPtr)
+            munmap(cqPtr, cqSize);
+        munmap(sqPtr, sqSize);
+        close(fd);
+    }
+
+    void add(int pfd, uint32_t data) override
+    {
+        Entry& entry = entries[data];
+        entry.fd = pfd;
+        entry.gen = ++genCount;
+        entry.armed = false;
+    }
+
+    void remove(int, uint32_t data) override
+    {
+        auto it = entries.find(data);
+        if (it == entries.end())
+            return;
+
+        if (it->second.armed) {
+            struct io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = userData(data, it->second);
+            sqe->user_data = ignoredData;
+
+            // the pending poll holds a reference on the file, drop it now
+            enter(0, 0);
+        }
+        entries.erase(it);
+    }
+
+    int wait(uint32_t* ready, int maxReady, int timeoutMs) override
+    {
+        for (auto& e : entries) {
+            if (!e.second.armed)
+                arm(e.first, e.second);
+        }
+
+        int n = reap(ready, maxReady);
+        if (n > 0 || timeoutMs == 0) {
+            enter(0, 0);
+            return n;
+        }
+
+        if (timeoutMs > 0) {
+            // completes with the first other completion or on expiry
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+
+            struct io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<uintptr_t>(&ts);
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = ignoredData;
+        }
+
+        if (!enter(1, IORING_ENTER_GETEVENTS))
+            return 0;
+
+        return reap(ready, maxReady);
+    }
+
+    const char* name() const override
+    {
+        return "io_uring";
+    }
+
+private:
+    struct Entry
+    {
+        int fd;
+        uint32_t gen;
+        bool armed;
+    };
+
+    static const unsigned ringEntries = 64;
+    static const uint64_t ignoredData = ~0ULL;
+
+    int fd = -1;
+    void* sqPtr = nullptr;
+    void* cqPtr = nullptr;
+    size_t sqSize = 0;
+    size_t cqSize = 0;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    struct io_uring_sqe* sqes;
+    unsigned toSubmit = 0;
+
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    // generation in the upper half, a completion of an fd added again
+    // after removal is told apart from a stale one
+    std::map<uint32_t, Entry> entries;
+    uint32_t genCount = 0;
+    struct __kernel_timespec ts = {};
+
+    static uint64_t userData(uint32_t data, const Entry& entry)
+    {
+        return static_cast<uint64_t>(entry.gen) << 32 | data;
+    }
+
+    static unsigned load(const unsigned* p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    static void store(unsigned* p, unsigned v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+
+    struct io_uring_sqe* getSqe()
+    {
+        unsigned tail = *sqTail;
+        if (tail - load(sqHead) == sqEntries) {
+            enter(0, 0);
+            tail = *sqTail;
+        }
+
+        unsigned index = tail & sqMask;
+        struct io_uring_sqe* sqe = &sqes[index];
+        *sqe = {};
+        sqArray[index] = index;
+        store(sqTail, tail + 1);
+        toSubmit++;
+
+        return sqe;
+    }
+
+    void arm(uint32_t data, Entry& entry)
+    {
+        struct io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = entry.fd;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = userData(data, entry);
+        entry.armed = true;
+    }
+
+    // false when interrupted
+    bool enter(unsigned minComplete, unsigned flags)
+    {
+        if (toSubmit == 0 && minComplete == 0)
+            return true;
+
+        int ret = syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                          flags, nullptr, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                return false;
+            throw std::runtime_error("io_uring_enter error, errno: " + std::to_string(errno));
+        }
+        toSubmit -= ret;
+
+        return true;
+    }
+
+    int reap(uint32_t* ready, int maxReady)
+    {
+        int n = 0;
+        unsigned head = *cqHead;
+        unsigned tail = load(cqTail);
+
+        for (; head != tail && n < maxReady; head++) {
+            const struct io_uring_cqe& cqe = cqes[head & cqMask];
+            if (cqe.user_data == ignoredData)
+                continue;
+
+            uint32_t data = static_cast<uint32_t>(cqe.user_data);
+            auto it = entries.find(data);
+            if (it == entries.end() ||
+                userData(data, it->second) != cqe.user_data)
+                continue;
+
+            // errors are reported as ready too, the reader finds out
+            it->second.armed = false;
+            ready[n++] = data;
+        }
+        store(cqHead, head);
+
+        return n;
+    }
+};
+} // namespace
+
+std::unique_ptr<Poller> createPoller(Poller::Backend backend)
+{
+    if (backend == Poller::Backend::IoUring) {
+        try {
+            return std::unique_ptr<Poller>(new UringPoller());
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << ", fall back to epoll" << std::endl;
+        }
+    }
+
+    return std::unique_ptr<Poller>(new EpollPoller());
+}
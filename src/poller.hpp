@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+
+/*
+ * readiness of a set of fds, level triggered like epoll without EPOLLET:
+ * a fd still readable on the next wait() is reported again. Each fd is
+ * reported through the data it was added with.
+ */
+class Poller
+{
+public:
+    enum class Backend
+    {
+        Epoll,
+        IoUring,
+    };
+
+    virtual ~Poller() = default;
+
+    virtual void add(int fd, uint32_t data) = 0;
+    virtual void remove(int fd, uint32_t data) = 0;
+
+    /*
+     * fills ready with the data of up to maxReady readable fds, timeoutMs
+     * of -1 waits forever. Returns 0 on timeout or when interrupted
+     */
+    virtual int wait(uint32_t* ready, int maxReady, int timeoutMs) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// falls back to epoll when io_uring is not usable on this kernel
+std::unique_ptr<Poller> createPoller(Poller::Backend backend);
@@ -0,0 +1,253 @@
+#include "recorder.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <stdexcept>
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void Recorder::AlignedFree::operator()(void* p) const
+{
+    std::free(p);
+}
+
+// zeroed, so padding written from it is deterministic
+Recorder::AlignedBuffer Recorder::allocAligned(size_t size)
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, session::blockSize, size)) {
+        throw std::bad_alloc();
+    }
+    std::memset(p, 0, size);
+
+    return AlignedBuffer(static_cast<unsigned char*>(p));
+}
+
+Recorder::Recorder(const std::string& path, enum v4l2::PixFormat pixFormat,
+                   int width, int height, int cameraNum, int maxPending) :
+    m_path(path),
+    m_maxPending(maxPending),
+    m_pending(cameraNum)
+{
+    if (pixFormat == v4l2::PixFormat::MJPEG) {
+        throw std::runtime_error("compressed frames can not be recorded");
+    }
+
+    m_header = {};
+    std::memcpy(m_header.magic, session::fileMagic, sizeof(m_header.magic));
+    m_header.version = session::version;
+    m_header.pixelFormat = static_cast<uint32_t>(pixFormat);
+    m_header.width = width;
+    m_header.height = height;
+    m_header.cameraNum = cameraNum;
+    m_header.frameSize = v4l2::frameSize(pixFormat, width, height);
+    m_payloadSize = session::alignUp(m_header.frameSize);
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC |
+                  O_DIRECT, 0644);
+    if (m_fd == -1 && errno == EINVAL) {
+        // tmpfs and some network file systems
+        std::cerr << path << ": no O_DIRECT, writing through the page cache"
+                  << std::endl;
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+    }
+    if (m_fd == -1) {
+        throw std::runtime_error("failed to create: " + path);
+    }
+
+    m_recordBlock = allocAligned(session::blockSize);
+    m_bounce = allocAligned(m_payloadSize);
+
+    std::memcpy(m_recordBlock.get(), &m_header, sizeof(m_header));
+    struct iovec iov = {m_recordBlock.get(), session::blockSize};
+    if (!writeAt(&iov, 1, 0)) {
+        ::close(m_fd);
+        throw std::runtime_error(path + ": failed to write header");
+    }
+    std::memset(m_recordBlock.get(), 0, session::blockSize);
+    m_offset = session::blockSize;
+}
+
+Recorder::~Recorder()
+{
+    stop();
+    ::close(m_fd);
+}
+
+void Recorder::start()
+{
+    m_thread = std::thread(&Recorder::run, this);
+}
+
+void Recorder::stop()
+{
+    m_stopped.store(true, std::memory_order_relaxed);
+
+    if (m_thread.joinable()) {
+        messaging::Sender(m_incoming).send(messaging::CloseQueue());
+        m_thread.join();
+
+        // after a failed write too, what was written stays readable
+        writeIndex();
+    }
+}
+
+void Recorder::push(const std::shared_ptr<PixelBufferBase>& frame)
+{
+    if (m_stopped.load(std::memory_order_relaxed) || failed())
+        return;
+
+    std::atomic<int>& pending = m_pending.at(frame->getIndex());
+    if (pending.load(std::memory_order_relaxed) >= m_maxPending) {
+        m_dropCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    pending.fetch_add(1, std::memory_order_relaxed);
+    messaging::Sender(m_incoming).send(Write{frame});
+}
+
+void Recorder::run()
+{
+    bool closed = false;
+
+    while (!closed) {
+        m_incoming.wait(closed)
+            .handle<Write>(
+                [&](Write& msg)
+                {
+                    if (!failed())
+                        write(*msg.frame);
+
+                    m_pending[msg.frame->getIndex()].fetch_sub(
+                            1, std::memory_order_relaxed);
+                    // hands the buffer back to the camera
+                    msg.frame.reset();
+                }
+            );
+    }
+}
+
+void Recorder::write(const PixelBufferBase& frame)
+{
+    int64_t begin = monotonicUs();
+
+    session::RecordHeader* record =
+        reinterpret_cast<session::RecordHeader*>(m_recordBlock.get());
+    record->magic = session::recordMagic;
+    record->camera = frame.getIndex();
+    record->timestamp = frame.getTimestamp();
+    record->sequence = frame.getSequence();
+    record->length = m_header.frameSize;
+
+    // the padding is read from behind the frame, which has to lie within
+    // the buffer, or comes zeroed from the bounce buffer
+    void* payload = frame.getStart();
+    if (m_bounceAlways ||
+        reinterpret_cast<uintptr_t>(payload) % session::blockSize ||
+        frame.getLength() < m_payloadSize) {
+        std::memcpy(m_bounce.get(), payload, m_header.frameSize);
+        payload = m_bounce.get();
+    }
+
+    struct iovec iov[2] = {
+        {m_recordBlock.get(), session::blockSize},
+        {payload, m_payloadSize},
+    };
+    bool written = writeAt(iov, 2, m_offset);
+    if (!written && errno == EFAULT && !m_bounceAlways) {
+        // driver memory mapped as pfns can not be pinned for direct io
+        m_bounceAlways = true;
+        std::memcpy(m_bounce.get(), frame.getStart(), m_header.frameSize);
+        iov[1].iov_base = m_bounce.get();
+        written = writeAt(iov, 2, m_offset);
+    }
+    if (!written) {
+        std::cerr << m_path << ": write failed, " << std::strerror(errno)
+                  << ", recording stopped" << std::endl;
+        m_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    session::IndexEntry entry = {};
+    entry.offset = m_offset + session::blockSize;
+    entry.timestamp = record->timestamp;
+    entry.camera = record->camera;
+    entry.sequence = record->sequence;
+    entry.length = record->length;
+    m_index.push_back(entry);
+
+    m_offset += session::blockSize + m_payloadSize;
+    m_bytesWritten.fetch_add(session::blockSize + m_payloadSize,
+                             std::memory_order_relaxed);
+    m_frameCount.fetch_add(1, std::memory_order_relaxed);
+    m_lastWriteUs.store(monotonicUs() - begin, std::memory_order_relaxed);
+}
+
+void Recorder::writeIndex()
+{
+    size_t indexSize = m_index.size() * sizeof(session::IndexEntry);
+    size_t size = session::alignUp(indexSize + sizeof(session::Trailer));
+    AlignedBuffer block = allocAligned(size);
+
+    std::memcpy(block.get(), m_index.data(), indexSize);
+
+    session::Trailer trailer = {};
+    trailer.indexOffset = m_offset;
+    trailer.entryCount = m_index.size();
+    std::memcpy(trailer.magic, session::trailerMagic, sizeof(trailer.magic));
+    std::memcpy(block.get() + size - sizeof(trailer), &trailer, sizeof(trailer));
+
+    struct iovec iov = {block.get(), size};
+    if (!writeAt(&iov, 1, m_offset) || fdatasync(m_fd)) {
+        std::cerr << m_path << ": failed to write the index" << std::endl;
+        m_failed.store(true, std::memory_order_relaxed);
+    }
+}
+
+// false on error, errno tells
+bool Recorder::writeAt(const struct iovec* iov_, int iovcnt, uint64_t offset)
+{
+    struct iovec iov[2];
+    std::memcpy(iov, iov_, iovcnt * sizeof(*iov));
+    struct iovec* cur = iov;
+
+    while (iovcnt) {
+        ssize_t n = pwritev(m_fd, cur, iovcnt, offset);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            if (n == 0)
+                errno = ENOSPC;
+            return false;
+        }
+
+        offset += n;
+        while (iovcnt && static_cast<size_t>(n) >= cur->iov_len) {
+            n -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt) {
+            cur->iov_base = static_cast<char*>(cur->iov_base) + n;
+            cur->iov_len -= n;
+        }
+    }
+
+    return true;
+}
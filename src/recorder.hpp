@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#include "message.hpp"
+#include "session.hpp"
+#include "v4l2capture.hpp"
+
+/*
+ * appends the frames of all cameras to a session file (see session.hpp) on
+ * a thread of its own. A frame, and with it the camera's buffer, is held
+ * until its write completed, so only a few may wait per camera before newer
+ * ones are dropped rather than starving the capture. The file is written
+ * with O_DIRECT to keep the page cache for the working set, frames not
+ * block aligned in memory go through a bounce buffer.
+ */
+class Recorder
+{
+public:
+    // throws when the file can not be created
+    Recorder(const std::string& path, enum v4l2::PixFormat pixFormat,
+             int width, int height, int cameraNum, int maxPending);
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+    ~Recorder();
+
+    // from the capture thread, the frame is shared with the display path
+    void push(const std::shared_ptr<PixelBufferBase>& frame);
+    void start();
+    // writes what is queued and the index, frames pushed later are ignored
+    void stop();
+
+    const std::string& getPath() const { return m_path; }
+    uint64_t getFrameCount() const
+    {
+        return m_frameCount.load(std::memory_order_relaxed);
+    }
+    // frames refused because maxPending of the camera waited already
+    uint64_t getDropCount() const
+    {
+        return m_dropCount.load(std::memory_order_relaxed);
+    }
+    uint64_t getBytesWritten() const
+    {
+        return m_bytesWritten.load(std::memory_order_relaxed);
+    }
+    // of the last frame's write
+    uint64_t getLastWriteUs() const
+    {
+        return m_lastWriteUs.load(std::memory_order_relaxed);
+    }
+    bool failed() const
+    {
+        return m_failed.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Write
+    {
+        std::shared_ptr<PixelBufferBase> frame;
+    };
+
+    struct AlignedFree
+    {
+        void operator()(void* p) const;
+    };
+    using AlignedBuffer = std::unique_ptr<unsigned char, AlignedFree>;
+
+    std::string m_path;
+    int m_fd = -1;
+    session::FileHeader m_header;
+    int m_maxPending;
+    uint64_t m_payloadSize;
+    uint64_t m_offset = 0;
+    bool m_bounceAlways = false;
+
+    AlignedBuffer m_recordBlock;
+    AlignedBuffer m_bounce;
+    std::vector<session::IndexEntry> m_index;
+    std::vector<std::atomic<int>> m_pending;
+
+    std::atomic<bool> m_stopped{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<uint64_t> m_frameCount{0};
+    std::atomic<uint64_t> m_dropCount{0};
+    std::atomic<uint64_t> m_bytesWritten{0};
+    std::atomic<uint64_t> m_lastWriteUs{0};
+
+    messaging::Receiver m_incoming;
+    std::thread m_thread;
+
+    static AlignedBuffer allocAligned(size_t size);
+
+    void run();
+    void write(const PixelBufferBase& frame);
+    void writeIndex();
+    bool writeAt(const struct iovec* iov, int iovcnt, uint64_t offset);
+};
@@ -10,6 +10,8 @@
 #include <cstring>
 #include <chrono>
 
+#include <unistd.h>
+
 #include <opencv2/opencv.hpp>
 
 #define GLM_FORCE_RADIANS
@@ -19,36 +21,73 @@
 #define WIDTH 800
 #define HEIGHT 600
 static const int MAX_FRAMES_IN_FLIGHT = 2;
+// work group size of demosaic.comp
+static const uint32_t DEMOSAIC_GROUP_SIZE = 16;
+// workgroups of compose.comp benchCompose tries: square tiles, and wide
+// ones following the rows of the surround table
+static const std::array<Render::ComposeGroup, 6> COMPOSE_GROUPS = {{
+    {8, 8}, {16, 8}, {16, 16}, {32, 4}, {32, 8}, {64, 2}}};
+
+// specialization constants of shader.frag
+struct FragConstants
+{
+    int32_t format;
+    int32_t remap;
+    int32_t surround;
+};
+
+// push constants of demosaic.comp
+struct DemosaicConstants
+{
+    float gains[4];
+    float blackLevel;
+    float whiteLevel;
+    uint32_t cfa;
+    uint32_t layerMask;
+};
 
-const std::vector<Render::Vertex> vertices = {
-    {{-1.0f, -1.0f}, {1.0f, 0.0f}},
-    {{0.0f, -1.0f}, {0.0f, 0.0f}},
-    {{-1.0f, 0.0f},  {1.0f, 1.0f}},
-    {{0.0f, 0.0f}, {0.0f, 1.0f}},
-
-    {{0.0f, -1.0f}, {1.0f, 0.0f}},
-    {{1.0f, -1.0f}, {0.0f, 0.0f}},
-    {{0.0f, 0.0f},  {1.0f, 1.0f}},
-    {{1.0f, 0.0f}, {0.0f, 1.0f}},
-
-    {{-1.0f, 0.0f}, {1.0f, 0.0f}},
-    {{0.0f, 0.0f}, {0.0f, 0.0f}},
-    {{-1.0f, 1.0f},  {1.0f, 1.0f}},
-    {{0.0f, 1.0f}, {0.0f, 1.0f}},
-
-    {{0.0f, 0.0f}, {1.0f, 0.0f}},
-    {{1.0f, 0.0f}, {0.0f, 0.0f}},
-    {{0.0f, 1.0f},  {1.0f, 1.0f}},
-    {{1.0f, 1.0f}, {0.0f, 1.0f}}
+// specialization constants of compose.comp
+struct ComposeSpecialization
+{
+    int32_t format;
+    uint32_t groupWidth;
+    uint32_t groupHeight;
 };
 
-const std::vector<uint16_t> indices = {
-    0, 1, 2, 3,
-    4, 5, 6, 7,
-    8, 9, 10, 11,
-    12, 13, 14, 15
+// push constants of compose.comp
+struct ComposeConstants
+{
+    int32_t offset[2];
+    int32_t size[2];
 };
 
+// bilinear lookup of a remap table at view coordinates u, v in 0..1
+static glm::vec2 sampleRemapTable(const std::vector<float>& table,
+                                  int width, int height, float u, float v)
+{
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    x = x < 0.0f ? 0.0f : (x > width - 1 ? width - 1 : x);
+    y = y < 0.0f ? 0.0f : (y > height - 1 ? height - 1 : y);
+
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    int x1 = x0 + 1 < width ? x0 + 1 : x0;
+    int y1 = y0 + 1 < height ? y0 + 1 : y0;
+    float fx = x - x0;
+    float fy = y - y0;
+
+    auto at = [&](int tx, int ty)
+    {
+        const float* p = &table[(static_cast<size_t>(ty) * width + tx) * 2];
+        return glm::vec2(p[0], p[1]);
+    };
+    glm::vec2 top = at(x0, y0) * (1.0f - fx) + at(x1, y0) * fx;
+    glm::vec2 bottom = at(x0, y1) * (1.0f - fx) + at(x1, y1) * fx;
+
+    return top * (1.0f - fy) + bottom * fy;
+}
+
 const std::vector<const char*> Render::validationLayers = {
     "VK_LAYER_LUNARG_standard_validation"
 };
@@ -57,6 +96,22 @@ const std::vector<const char*> Render::deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+const std::vector<const char*> Render::externalMemoryInstanceExtensions = {
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME
+};
+
+const std::vector<const char*> Render::dmaBufDeviceExtensions = {
+    VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+    VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME
+};
+
+const std::vector<const char*> Render::hostImportDeviceExtensions = {
+    VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+    VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME
+};
+
 static PFN_vkDestroyDebugReportCallbackEXT pfn_vkDestroyDebugReportCallbackEXT;
 void vkDestroyDebugReportCallbackEXT(
         VkInstance                                  instance,
@@ -85,14 +140,56 @@ VkResult vkCreateDebugReportCallbackEXT(
             );
 }
 
+static PFN_vkGetMemoryFdPropertiesKHR pfn_vkGetMemoryFdPropertiesKHR;
+VkResult vkGetMemoryFdPropertiesKHR(
+        VkDevice                                    device,
+        VkExternalMemoryHandleTypeFlagBits          handleType,
+        int                                         fd,
+        VkMemoryFdPropertiesKHR*                    pMemoryFdProperties)
+{
+    return pfn_vkGetMemoryFdPropertiesKHR(
+            device,
+            handleType,
+            fd,
+            pMemoryFdProperties
+            );
+}
+
+static PFN_vkGetMemoryHostPointerPropertiesEXT pfn_vkGetMemoryHostPointerPropertiesEXT;
+VkResult vkGetMemoryHostPointerPropertiesEXT(
+        VkDevice                                    device,
+        VkExternalMemoryHandleTypeFlagBits          handleType,
+        const void*                                 pHostPointer,
+        VkMemoryHostPointerPropertiesEXT*           pMemoryHostPointerProperties)
+{
+    return pfn_vkGetMemoryHostPointerPropertiesEXT(
+            device,
+            handleType,
+            pHostPointer,
+            pMemoryHostPointerProperties
+            );
+}
+
+static PFN_vkGetPhysicalDeviceProperties2KHR pfn_vkGetPhysicalDeviceProperties2KHR;
+void vkGetPhysicalDeviceProperties2KHR(
+        VkPhysicalDevice                            physicalDevice,
+        VkPhysicalDeviceProperties2*                pProperties)
+{
+    pfn_vkGetPhysicalDeviceProperties2KHR(
+            physicalDevice,
+            pProperties
+            );
+}
+
 Render::Render()
 {
 }
 
-Render::Render(int width, int height, int pixelSize_, int camNum_, int camBufNum_) :
+Render::Render(int width, int height, InputFormat inputFormat_, int camNum_,
+               int camBufNum_) :
     textureWidth(width),
     textureHeight(height),
-    pixelSize(pixelSize_),
+    inputFormat(inputFormat_),
     camNum(camNum_),
     camBufNum(camBufNum_)
 {
@@ -100,7 +197,11 @@ Render::Render(int width, int height, int pixelSize_, int camNum_, int camBufNum
 
 Render::~Render()
 {
-    m_device->unmapMemory(*m_uStageMem);
+    m_device->waitIdle();
+    m_frameUploads.clear();
+    m_pendingUploads.clear();
+    if (m_stagingMode == StagingMode::HostCoherent)
+        m_device->unmapMemory(*m_uStageMem);
 }
 
 void Render::init()
@@ -121,9 +222,15 @@ void Render::init()
     createRenderPass();
     createDescriptorSetLayout();
     createGraphicsPipeline();
+    if (isBayer())
+        createDemosaicPipeline();
+    if (hasSurround())
+        createComposePipeline();
     createFramebuffers();
     createCommandPool();
     createTextureImage();
+    createRemapImage();
+    createSurroundImage();
     createTextureImageView();
     createTextureSampler();
     createVertexBuffer();
@@ -131,44 +238,578 @@ void Render::init()
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
-    createCommandBuffers(0);
+    createComposeImage();
+    createCommandBuffers();
     createSyncObjects();
+    createTimestampPool();
 }
 
 void Render::updateTexture(const std::shared_ptr<PixelBufferBase>& pbuf)
 {
-    int frameSize = textureWidth * textureHeight * pixelSize;
+    if (!pbuf || !pbuf->getStart())
+        return;
+    // may still come from before the camera was lost
+    if (m_lostMask >> pbuf->getIndex() & 1)
+        return;
 
-    transitionImageLayout(*m_utextureImage, vk::ImageLayout::eUndefined,
-                          vk::ImageLayout::eTransferDstOptimal,
-                          vk::PipelineStageFlagBits::eTopOfPipe,
-                          vk::PipelineStageFlagBits::eTransfer);
-    vk::BufferImageCopy copyRegion(frameSize * (pbuf->getIndex() * camNum + pbuf->getSubIndex()),
-                                   0, 0,
-                                   vk::ImageSubresourceLayers(
+    // a newer frame for the same layer supersedes the pending one
+    for (auto& pending : m_pendingUploads) {
+        if (pending->getIndex() == pbuf->getIndex()) {
+            pending = pbuf;
+            return;
+        }
+    }
+
+    m_pendingUploads.push_back(pbuf);
+}
+
+void Render::setCameraLost(int camIndex, bool lost)
+{
+    if (camIndex < 0 || camIndex >= camNum)
+        return;
+
+    uint32_t bit = 1U << camIndex;
+    if (!lost) {
+        m_lostMask &= ~bit;
+        m_placeholderMask &= ~bit;
+        return;
+    }
+
+    m_lostMask |= bit;
+    m_placeholderMask |= bit;
+    for (auto it = m_pendingUploads.begin(); it != m_pendingUploads.end(); ) {
+        if ((*it)->getIndex() == camIndex)
+            it = m_pendingUploads.erase(it);
+        else
+            ++it;
+    }
+}
+
+/*
+ * clears the layers of lost cameras to dark gray, in the layout of each
+ * texture: yuv textures hold neutral chroma, bayer input is cleared after
+ * the demosaic pass, whose output the draw samples
+ */
+void Render::recordPlaceholders(vk::CommandBuffer cmd)
+{
+    if (!m_placeholderMask)
+        return;
+
+    const float gray = 0.25f;
+    std::array<float, 4> luma = {gray, gray, gray, 1.0f};
+    if (inputFormat == InputFormat::YUYV)
+        luma = {gray, 0.5f, gray, 0.5f};
+    std::array<float, 4> chroma = {0.5f, 0.5f, 0.0f, 0.0f};
+
+    struct Target
+    {
+        vk::Image image;
+        vk::ClearColorValue color;
+    };
+    std::vector<Target> targets;
+    if (isBayer()) {
+        targets.push_back({*m_udemosaicImage, vk::ClearColorValue(luma)});
+    } else {
+        targets.push_back({*m_utextureImage, vk::ClearColorValue(luma)});
+        if (m_uchromaImage)
+            targets.push_back({*m_uchromaImage, vk::ClearColorValue(chroma)});
+    }
+
+    // the demosaic output stays in the general layout
+    vk::ImageLayout readLayout = isBayer() ?
+        vk::ImageLayout::eGeneral : vk::ImageLayout::eShaderReadOnlyOptimal;
+    vk::ImageLayout clearLayout = isBayer() ?
+        vk::ImageLayout::eGeneral : vk::ImageLayout::eTransferDstOptimal;
+    vk::PipelineStageFlags readStage = vk::PipelineStageFlagBits::eFragmentShader |
+                                       vk::PipelineStageFlagBits::eComputeShader;
+
+    for (int cam = 0; cam < camNum; cam++) {
+        if (!(m_placeholderMask >> cam & 1))
+            continue;
+
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor,
+                                        0, 1, cam, 1);
+        for (const auto& target : targets) {
+            vk::ImageMemoryBarrier barrier(vk::AccessFlagBits::eShaderRead,
+                                           vk::AccessFlagBits::eTransferWrite,
+                                           readLayout, clearLayout,
+                                           VK_QUEUE_FAMILY_IGNORED,
+                                           VK_QUEUE_FAMILY_IGNORED,
+                                           target.image, range);
+            cmd.pipelineBarrier(readStage, vk::PipelineStageFlagBits::eTransfer,
+                                {}, nullptr, nullptr, barrier);
+
+            cmd.clearColorImage(target.image, clearLayout, target.color, range);
+
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.oldLayout = clearLayout;
+            barrier.newLayout = readLayout;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, readStage,
+                                {}, nullptr, nullptr, barrier);
+        }
+    }
+
+    m_placeholderMask = 0;
+}
+
+// returns the layers written
+uint32_t Render::recordUploads(vk::CommandBuffer cmd)
+{
+    if (m_pendingUploads.empty())
+        return 0;
+
+    // raw bayer layers are read by the demosaic pass, the others by the
+    // draw or by compose.comp
+    vk::PipelineStageFlags readStage = vk::PipelineStageFlagBits::eComputeShader;
+    if (!isBayer())
+        readStage |= vk::PipelineStageFlagBits::eFragmentShader;
+    uint32_t layerMask = 0;
+
+    m_uploadBarriers.clear();
+    for (const auto& pbuf : m_pendingUploads) {
+        vk::ImageMemoryBarrier barrier({}, vk::AccessFlagBits::eTransferWrite,
+                                       vk::ImageLayout::eShaderReadOnlyOptimal,
+                                       vk::ImageLayout::eTransferDstOptimal,
+                                       VK_QUEUE_FAMILY_IGNORED,
+                                       VK_QUEUE_FAMILY_IGNORED,
+                                       *m_utextureImage,
+                                       vk::ImageSubresourceRange(
+                                           vk::ImageAspectFlagBits::eColor,
+                                           0, 1, pbuf->getIndex(), 1));
+        m_uploadBarriers.push_back(barrier);
+        if (m_uchromaImage) {
+            barrier.image = *m_uchromaImage;
+            m_uploadBarriers.push_back(barrier);
+        }
+        layerMask |= 1U << pbuf->getIndex();
+    }
+
+    // the previous frame may still be sampling these layers
+    cmd.pipelineBarrier(readStage, vk::PipelineStageFlagBits::eTransfer, {},
+                        nullptr, nullptr, m_uploadBarriers);
+
+    vk::Extent3D extent = getTextureExtent();
+    for (const auto& pbuf : m_pendingUploads) {
+        const StageRegion& region =
+            m_stageRegions.at(pbuf->getIndex()).at(pbuf->getSubIndex());
+        vk::ImageSubresourceLayers layer(vk::ImageAspectFlagBits::eColor,
+                                         0, pbuf->getIndex(), 1);
+        cmd.copyBufferToImage(region.buffer, *m_utextureImage,
+                              vk::ImageLayout::eTransferDstOptimal,
+                              vk::BufferImageCopy(region.offset, 0, 0, layer,
+                                                  vk::Offset3D(0, 0, 0),
+                                                  extent));
+
+        // the CbCr plane directly follows the luma plane
+        if (m_uchromaImage) {
+            cmd.copyBufferToImage(region.buffer, *m_uchromaImage,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  vk::BufferImageCopy(
+                                      region.offset +
+                                          static_cast<vk::DeviceSize>(textureWidth) *
+                                          textureHeight,
+                                      0, 0, layer, vk::Offset3D(0, 0, 0),
+                                      vk::Extent3D(textureWidth / 2,
+                                                   textureHeight / 2, 1)));
+        }
+    }
+
+    for (auto& barrier : m_uploadBarriers) {
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    }
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, readStage, {},
+                        nullptr, nullptr, m_uploadBarriers);
+
+    // staging slots go back to the capture side once this frame's fence
+    // has signaled
+    m_frameUploads.at(m_currentFrame).swap(m_pendingUploads);
+
+    return layerMask;
+}
+
+// one dispatch over all layers, those not uploaded this frame return early
+void Render::recordDemosaic(vk::CommandBuffer cmd, uint32_t layerMask)
+{
+    if (!layerMask)
+        return;
+
+    vk::ImageMemoryBarrier barrier({}, vk::AccessFlagBits::eShaderWrite,
+                                   vk::ImageLayout::eGeneral,
+                                   vk::ImageLayout::eGeneral,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   *m_udemosaicImage,
+                                   vk::ImageSubresourceRange(
                                        vk::ImageAspectFlagBits::eColor,
-                                       0, pbuf->getIndex(), 1), vk::Offset3D(0, 0, 0),
-                                   vk::Extent3D(textureWidth, textureHeight, 1));
-    std::vector<vk::UniqueCommandBuffer> ucmdBuffers =
-        m_device->allocateCommandBuffersUnique(
-                vk::CommandBufferAllocateInfo(*m_commandPool,
-                                              vk::CommandBufferLevel::ePrimary,
-                                              1));
-    ucmdBuffers[0]->begin(
-            vk::CommandBufferBeginInfo(
+                                       0, 1, 0, camNum));
+
+    // the previous frame may still be sampling the output
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader |
+                        vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eComputeShader, {},
+                        nullptr, nullptr, barrier);
+
+    float whiteLevel = m_bayerParams.whiteLevel;
+    if (whiteLevel <= 0.0f)
+        whiteLevel = inputFormat == InputFormat::Bayer10 ? 1023.0f : 4095.0f;
+
+    DemosaicConstants constants = {
+        {m_bayerParams.gainR, m_bayerParams.gainG, m_bayerParams.gainB, 1.0f},
+        m_bayerParams.blackLevel, whiteLevel,
+        static_cast<uint32_t>(m_bayerParams.pattern), layerMask};
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *m_demosaicPipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                           *m_demosaicPipelineLayout, 0, 1, &*m_demosaicSet,
+                           0, nullptr);
+    cmd.pushConstants(*m_demosaicPipelineLayout,
+                      vk::ShaderStageFlagBits::eCompute, 0,
+                      sizeof(constants), &constants);
+    cmd.dispatch((textureWidth + DEMOSAIC_GROUP_SIZE - 1) / DEMOSAIC_GROUP_SIZE,
+                 (textureHeight + DEMOSAIC_GROUP_SIZE - 1) / DEMOSAIC_GROUP_SIZE,
+                 camNum);
+
+    barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eFragmentShader |
+                        vk::PipelineStageFlagBits::eComputeShader, {},
+                        nullptr, nullptr, barrier);
+}
+
+/*
+ * the surround view by compose.comp into the storage image, which is then
+ * blitted into the swapchain image, the render pass is skipped
+ */
+void Render::recordCompose(vk::CommandBuffer cmd, uint32_t imageIndex)
+{
+    beginComposeTime(cmd, Compose::Compute);
+    recordComposeDispatch(cmd);
+    recordComposeBlit(cmd, imageIndex, false);
+    endComposeTime(cmd);
+}
+
+// into this frame's image, whose last blit the frame's fence has waited for
+void Render::recordComposeDispatch(vk::CommandBuffer cmd)
+{
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor,
+                                    0, 1, 0, 1);
+    // the old contents are dropped, so the graphics queue does not have to
+    // hand it back either
+    vk::ImageMemoryBarrier barrier({}, vk::AccessFlagBits::eShaderWrite,
+                                   vk::ImageLayout::eUndefined,
+                                   vk::ImageLayout::eGeneral,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   *m_ucomposeImages.at(m_currentFrame),
+                                   range);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eComputeShader, {},
+                        nullptr, nullptr, barrier);
+
+    // the top view fit into the window as it is now
+    int32_t width = m_swapChainExtent.width;
+    int32_t height = static_cast<int64_t>(width) * surroundHeight /
+                     surroundWidth;
+    if (height > static_cast<int32_t>(m_swapChainExtent.height)) {
+        height = m_swapChainExtent.height;
+        width = static_cast<int64_t>(height) * surroundWidth / surroundHeight;
+    }
+    ComposeConstants constants = {
+        {(static_cast<int32_t>(m_swapChainExtent.width) - width) / 2,
+         (static_cast<int32_t>(m_swapChainExtent.height) - height) / 2},
+        {width, height}};
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *m_composePipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                           *m_composePipelineLayout, 0, 1,
+                           &*m_composeSets.at(m_currentFrame), 0, nullptr);
+    cmd.pushConstants(*m_composePipelineLayout,
+                      vk::ShaderStageFlagBits::eCompute, 0,
+                      sizeof(constants), &constants);
+    cmd.dispatch((m_swapChainExtent.width + m_composeGroup.width - 1) /
+                     m_composeGroup.width,
+                 (m_swapChainExtent.height + m_composeGroup.height - 1) /
+                     m_composeGroup.height, 1);
+}
+
+/*
+ * with acquire the image comes from the compute queue, the other half of
+ * the release submitAsyncCompose records there
+ */
+void Render::recordComposeBlit(vk::CommandBuffer cmd, uint32_t imageIndex,
+                               bool acquire)
+{
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor,
+                                    0, 1, 0, 1);
+    vk::Image composeImage = *m_ucomposeImages.at(m_currentFrame);
+    vk::Image swapChainImage = m_swapChainImages.at(imageIndex);
+    std::array<vk::ImageMemoryBarrier, 2> toBlit = {
+        vk::ImageMemoryBarrier(acquire ? vk::AccessFlags() :
+                                         vk::AccessFlagBits::eShaderWrite,
+                               vk::AccessFlagBits::eTransferRead,
+                               vk::ImageLayout::eGeneral,
+                               vk::ImageLayout::eTransferSrcOptimal,
+                               acquire ? m_computeFamily :
+                                         VK_QUEUE_FAMILY_IGNORED,
+                               acquire ? m_graphicsFamily :
+                                         VK_QUEUE_FAMILY_IGNORED,
+                               composeImage, range),
+        vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite,
+                               vk::ImageLayout::eUndefined,
+                               vk::ImageLayout::eTransferDstOptimal,
+                               VK_QUEUE_FAMILY_IGNORED,
+                               VK_QUEUE_FAMILY_IGNORED,
+                               swapChainImage, range)};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                        vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eTransfer, {},
+                        nullptr, nullptr, toBlit);
+
+    vk::ImageSubresourceLayers layer(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    std::array<vk::Offset3D, 2> area = {
+        vk::Offset3D(0, 0, 0),
+        vk::Offset3D(m_swapChainExtent.width, m_swapChainExtent.height, 1)};
+    cmd.blitImage(composeImage, vk::ImageLayout::eTransferSrcOptimal,
+                  swapChainImage, vk::ImageLayout::eTransferDstOptimal,
+                  vk::ImageBlit(layer, area, layer, area),
+                  vk::Filter::eNearest);
+
+    vk::ImageMemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, {},
+                                   vk::ImageLayout::eTransferDstOptimal,
+                                   vk::ImageLayout::ePresentSrcKHR,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   swapChainImage, range);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                        nullptr, nullptr, barrier);
+}
+
+/*
+ * cmd, holding the uploads, is submitted on its own after the given waits.
+ * The dispatch waits for it on the compute queue and the blit for the
+ * dispatch back on the graphics queue, which meanwhile is free to finish
+ * the previous frame
+ */
+void Render::submitAsyncCompose(vk::CommandBuffer cmd, uint32_t imageIndex,
+                                uint32_t uploadWaitCount,
+                                const vk::Semaphore* uploadWaits,
+                                const vk::PipelineStageFlags* uploadWaitStages,
+                                const uint64_t* uploadWaitValues,
+                                vk::Fence fence)
+{
+    vk::CommandBuffer composeCmd = *m_composeCommandBuffers.at(m_currentFrame);
+    composeCmd.begin(vk::CommandBufferBeginInfo(
                 vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
-    ucmdBuffers[0]->copyBufferToImage(*m_uStageBuffer, *m_utextureImage,
-                                         vk::ImageLayout::eTransferDstOptimal,
-                                         copyRegion);
-    ucmdBuffers[0]->end();
-    m_graphicsQueue.submit(vk::SubmitInfo(0, nullptr, nullptr, 1,
-                                          &*ucmdBuffers[0]), {});
-    m_graphicsQueue.waitIdle();
-    transitionImageLayout(*m_utextureImage, vk::ImageLayout::eTransferDstOptimal,
-                          vk::ImageLayout::eShaderReadOnlyOptimal,
-                          vk::PipelineStageFlagBits::eTransfer,
-                          vk::PipelineStageFlagBits::eFragmentShader);
+    beginComposeTime(composeCmd, Compose::AsyncCompute);
+    recordComposeDispatch(composeCmd);
+
+    // released to the graphics queue, which acquires it in recordComposeBlit
+    vk::ImageMemoryBarrier release(vk::AccessFlagBits::eShaderWrite, {},
+                                   vk::ImageLayout::eGeneral,
+                                   vk::ImageLayout::eTransferSrcOptimal,
+                                   m_computeFamily, m_graphicsFamily,
+                                   *m_ucomposeImages.at(m_currentFrame),
+                                   vk::ImageSubresourceRange(
+                                       vk::ImageAspectFlagBits::eColor,
+                                       0, 1, 0, 1));
+    composeCmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                               vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                               nullptr, nullptr, release);
+    endComposeTime(composeCmd);
+    composeCmd.end();
+
+    vk::CommandBuffer blitCmd = *m_blitCommandBuffers.at(m_currentFrame);
+    blitCmd.begin(vk::CommandBufferBeginInfo(
+                vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    recordComposeBlit(blitCmd, imageIndex, true);
+    blitCmd.end();
+
+    // the next frame waits for the dispatch before it uploads, a binary
+    // semaphore can only be waited for once so the blit gets its own
+    vk::Semaphore uploaded;
+    std::array<vk::Semaphore, 2> composed;
+    uint64_t uploadedValue = 0, composedValue = 0;
+    uint32_t composedCount = 1;
+    if (m_composeTimeline) {
+        uploaded = composed[0] = *m_composeTimeline;
+        uploadedValue = ++m_composeTimelineValue;
+        composedValue = ++m_composeTimelineValue;
+        m_composeReads = *m_composeTimeline;
+        m_composeReadsValue = composedValue;
+    } else {
+        uploaded = *m_uploadedSemaphores.at(m_currentFrame);
+        composed[0] = *m_composedSemaphores.at(m_currentFrame);
+        composed[1] = *m_composeReadSemaphores.at(m_currentFrame);
+        composedCount = 2;
+        m_composeReads = composed[1];
+    }
+    std::array<uint64_t, 2> composedValues = {composedValue, 0};
+
+    submitFrame(m_graphicsQueue, cmd, uploadWaitCount, uploadWaits,
+                uploadWaitStages, uploadWaitValues, 1, &uploaded,
+                &uploadedValue, nullptr);
+
+    vk::PipelineStageFlags composeStage =
+        vk::PipelineStageFlagBits::eComputeShader;
+    submitFrame(m_computeQueue, composeCmd, 1, &uploaded, &composeStage,
+                &uploadedValue, composedCount, composed.data(),
+                composedValues.data(), nullptr);
+
+    // the swapchain image and the composed one are first touched by the blit
+    std::array<vk::Semaphore, 2> waits = {
+        *m_imageAvailableSemaphores.at(m_currentFrame), composed[0]};
+    std::array<vk::PipelineStageFlags, 2> waitStages = {
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer};
+    std::array<uint64_t, 2> waitValues = {0, composedValue};
+    uint64_t noValue = 0;
+    submitFrame(m_graphicsQueue, blitCmd, waits.size(), waits.data(),
+                waitStages.data(), waitValues.data(), 1,
+                &*m_renderFinishedSemaphores.at(m_currentFrame), &noValue,
+                fence);
+}
+
+// the values are those of the timeline semaphore, binary ones ignore them
+void Render::submitFrame(vk::Queue queue, vk::CommandBuffer cmd,
+                         uint32_t waitCount, const vk::Semaphore* waits,
+                         const vk::PipelineStageFlags* waitStages,
+                         const uint64_t* waitValues, uint32_t signalCount,
+                         const vk::Semaphore* signals,
+                         const uint64_t* signalValues, vk::Fence fence)
+{
+    vk::SubmitInfo submitInfo(waitCount, waits, waitStages, 1, &cmd,
+                              signalCount, signals);
+#ifdef VK_KHR_timeline_semaphore
+    vk::TimelineSemaphoreSubmitInfoKHR timelineInfo(waitCount, waitValues,
+                                                    signalCount, signalValues);
+    if (m_composeTimeline)
+        submitInfo.pNext = &timelineInfo;
+#endif
+
+    vk::Result result = queue.submit(1, &submitInfo, fence);
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to submit draw command buffer!");
+}
+
+// the second timestamp is written once everything in between has finished
+void Render::beginComposeTime(vk::CommandBuffer cmd, Compose compose)
+{
+    if (!m_timestampPool ||
+        (compose == Compose::AsyncCompute && !m_computeTimestampMask))
+        return;
+
+    uint32_t first = m_currentFrame * 2;
+    cmd.resetQueryPool(*m_timestampPool, first, 2);
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                       *m_timestampPool, first);
+    m_timedCompose.at(m_currentFrame) = static_cast<int>(compose);
+}
+
+void Render::endComposeTime(vk::CommandBuffer cmd)
+{
+    if (!m_timestampPool || m_timedCompose.at(m_currentFrame) < 0)
+        return;
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                       *m_timestampPool, m_currentFrame * 2 + 1);
+}
+
+// once the frame's fence has signaled
+void Render::collectComposeTime()
+{
+    if (!m_timestampPool || m_timedCompose.at(m_currentFrame) < 0)
+        return;
 
+    int compose = m_timedCompose.at(m_currentFrame);
+    m_timedCompose.at(m_currentFrame) = -1;
+
+    uint64_t ticks[2];
+    vk::Result result =
+        m_device->getQueryPoolResults(*m_timestampPool, m_currentFrame * 2, 2,
+                                      sizeof(ticks), ticks, sizeof(ticks[0]),
+                                      vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return;
+
+    uint64_t mask = compose == static_cast<int>(Compose::AsyncCompute) ?
+                    m_computeTimestampMask : m_timestampMask;
+    uint64_t elapsed = (ticks[1] - ticks[0]) & mask;
+    m_composeTimes[compose].add(
+            static_cast<int64_t>(elapsed * m_timestampPeriod / 1000.0));
+}
+
+std::vector<Render::BenchResult> Render::benchCompose(int frames)
+{
+    std::vector<BenchResult> results;
+    if (!hasSurround() || frames <= 0)
+        return results;
+
+    View view = m_view;
+    Compose compose = m_compose;
+    ComposeGroup group = m_composeGroup;
+    m_view = View::Surround;
+
+    results.push_back(benchRun(Compose::Raster, frames));
+    if (supportsComputeCompose()) {
+        for (const ComposeGroup& candidate : COMPOSE_GROUPS) {
+            if (!supportsComposeGroup(candidate))
+                continue;
+            setComposeGroup(candidate);
+            results.push_back(benchRun(Compose::Compute, frames));
+        }
+        setComposeGroup(group);
+    }
+    if (supportsAsyncCompose())
+        results.push_back(benchRun(Compose::AsyncCompute, frames));
+
+    m_view = view;
+    m_compose = compose;
+
+    return results;
+}
+
+/*
+ * the timestamps of the last frames in flight are read once they are done,
+ * so each run only counts its own frames
+ */
+Render::BenchResult Render::benchRun(Compose compose, int frames)
+{
+    m_compose = compose;
+    GpuTime& time = m_composeTimes[static_cast<int>(compose)];
+
+    m_device->waitIdle();
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        collectComposeTime();
+        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+    time.reset();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        render(0);
+    }
+    m_device->waitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        collectComposeTime();
+        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+
+    uint64_t count = time.count.load(std::memory_order_relaxed);
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+            end - begin).count();
+
+    return {compose, m_composeGroup, frames,
+            count ? time.total.load(std::memory_order_relaxed) /
+                    static_cast<int64_t>(count) : 0,
+            time.max.load(std::memory_order_relaxed), us / frames};
 }
 
 std::vector<std::vector<PixelBufferBase>> Render::getBufferBank()
@@ -176,10 +817,171 @@ std::vector<std::vector<PixelBufferBase>> Render::getBufferBank()
     return m_stageMemMaps;
 }
 
+void Render::importDmaBuf(int camIndex,
+                          const std::vector<PixelBufferBase>& buffers,
+                          const std::vector<int>& fds)
+{
+    if (!m_dmaBufImport) {
+        throw std::runtime_error("dma-buf import not supported");
+    }
+
+    if (camIndex < 0 || camIndex >= camNum || buffers.size() != fds.size()) {
+        throw std::runtime_error("invalid dma-buf import params");
+    }
+
+    vk::DeviceSize frameSize = getFrameSize();
+    std::vector<StageRegion> regions;
+    std::vector<vk::UniqueBuffer> importedBuffers;
+    std::vector<vk::UniqueDeviceMemory> importedMems;
+
+    // either every buffer of the camera is imported or none, a half
+    // imported camera would upload from the wrong memory
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (buffers[i].getLength() < frameSize) {
+            throw std::runtime_error("dma-buf smaller than a frame");
+        }
+
+        vk::ExternalMemoryBufferCreateInfo externalInfo(
+                vk::ExternalMemoryHandleTypeFlagBits::eDmaBufEXT);
+        vk::BufferCreateInfo bufferInfo({}, buffers[i].getLength(),
+                                        vk::BufferUsageFlagBits::eTransferSrc);
+        bufferInfo.pNext = &externalInfo;
+        vk::UniqueBuffer buffer = m_device->createBufferUnique(bufferInfo);
+
+        vk::MemoryRequirements memRequirements =
+            m_device->getBufferMemoryRequirements(*buffer);
+        vk::MemoryFdPropertiesKHR fdProperties =
+            m_device->getMemoryFdPropertiesKHR(
+                    vk::ExternalMemoryHandleTypeFlagBits::eDmaBufEXT, fds[i]);
+        uint32_t memoryTypeIndex =
+            findMemoryType(memRequirements.memoryTypeBits &
+                           fdProperties.memoryTypeBits, {});
+
+        // a successful import takes ownership of the fd
+        int fd = dup(fds[i]);
+        if (fd == -1) {
+            throw std::runtime_error("failed to dup dma-buf fd");
+        }
+        vk::ImportMemoryFdInfoKHR importInfo(
+                vk::ExternalMemoryHandleTypeFlagBits::eDmaBufEXT, fd);
+        vk::MemoryAllocateInfo allocInfo(memRequirements.size, memoryTypeIndex);
+        allocInfo.pNext = &importInfo;
+
+        vk::UniqueDeviceMemory memory;
+        try {
+            memory = m_device->allocateMemoryUnique(allocInfo);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        m_device->bindBufferMemory(*buffer, *memory, 0);
+
+        regions.push_back(StageRegion{*buffer, 0});
+        importedBuffers.push_back(std::move(buffer));
+        importedMems.push_back(std::move(memory));
+    }
+
+    m_dmaBufBuffers.resize(camNum);
+    m_dmaBufMems.resize(camNum);
+    // frames in flight may still copy from the camera's earlier buffers,
+    // they go once each frame slot's fence has signaled again
+    if (!m_dmaBufBuffers[camIndex].empty()) {
+        m_retiredDmaBufs.push_back(
+                RetiredDmaBuf{std::move(m_dmaBufBuffers[camIndex]),
+                              std::move(m_dmaBufMems[camIndex]),
+                              MAX_FRAMES_IN_FLIGHT});
+    }
+
+    m_stageRegions.at(camIndex) = regions;
+    m_dmaBufBuffers[camIndex] = std::move(importedBuffers);
+    m_dmaBufMems[camIndex] = std::move(importedMems);
+}
+
+void Render::importHostMemory(void* base, size_t size,
+                              const std::vector<std::vector<PixelBufferBase>>& frames)
+{
+    if (!m_hostImport) {
+        throw std::runtime_error("VK_EXT_external_memory_host not supported");
+    }
+
+    if (frames.size() != static_cast<size_t>(camNum)) {
+        throw std::runtime_error("invalid host memory import params");
+    }
+
+    vk::DeviceSize alignment = std::max<vk::DeviceSize>(
+            m_importedHostPointerAlignment, sysconf(_SC_PAGESIZE));
+    if (reinterpret_cast<uintptr_t>(base) % alignment || size % alignment) {
+        throw std::runtime_error("host memory not aligned for import");
+    }
+
+    vk::DeviceSize frameSize = getFrameSize();
+    std::vector<std::vector<StageRegion>> regions(camNum);
+    for (int i = 0; i < camNum; i++) {
+        for (const auto& frame : frames[i]) {
+            vk::DeviceSize offset = static_cast<char*>(frame.getStart()) -
+                                    static_cast<char*>(base);
+            if (frame.getStart() < base || frame.getLength() < frameSize ||
+                offset + frameSize > size) {
+                throw std::runtime_error("frame outside the imported memory");
+            }
+            regions[i].push_back(StageRegion{vk::Buffer(), offset});
+        }
+    }
+
+    vk::MemoryHostPointerPropertiesEXT hostProperties =
+        m_device->getMemoryHostPointerPropertiesEXT(
+                vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, base);
+
+    vk::ExternalMemoryBufferCreateInfo externalInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT);
+    vk::BufferCreateInfo bufferInfo({}, size,
+                                    vk::BufferUsageFlagBits::eTransferSrc);
+    bufferInfo.pNext = &externalInfo;
+    vk::UniqueBuffer buffer = m_device->createBufferUnique(bufferInfo);
+
+    vk::MemoryRequirements memRequirements =
+        m_device->getBufferMemoryRequirements(*buffer);
+    if (memRequirements.size > size) {
+        throw std::runtime_error("buffer larger than the host memory");
+    }
+    uint32_t memoryTypeIndex =
+        findMemoryType(memRequirements.memoryTypeBits &
+                       hostProperties.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eHostVisible);
+
+    vk::ImportMemoryHostPointerInfoEXT importInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, base);
+    vk::MemoryAllocateInfo allocInfo(size, memoryTypeIndex);
+    allocInfo.pNext = &importInfo;
+    vk::UniqueDeviceMemory memory = m_device->allocateMemoryUnique(allocInfo);
+    m_device->bindBufferMemory(*buffer, *memory, 0);
+
+    for (int i = 0; i < camNum; i++) {
+        for (auto& region : regions[i]) {
+            region.buffer = *buffer;
+        }
+        m_stageRegions[i] = regions[i];
+    }
+    m_importedBuffers.push_back(std::move(buffer));
+    m_importedMems.push_back(std::move(memory));
+}
+
 void Render::render(int index)
 {
-    m_device->waitForFences(1, &*m_inFlightFences.at(m_currentFrame),
-                            VK_TRUE, std::numeric_limits<uint64_t>::max());
+    vk::Fence inFlightFence = *m_inFlightFences.at(m_currentFrame);
+
+    // only this slot's previous use has to be finished, the other frame in
+    // flight keeps running on the gpu while we record
+    m_device->waitForFences(1, &inFlightFence, VK_TRUE,
+                            std::numeric_limits<uint64_t>::max());
+    m_frameUploads.at(m_currentFrame).clear();
+    for (auto it = m_retiredDmaBufs.begin(); it != m_retiredDmaBufs.end(); ) {
+        if (--it->fencesLeft == 0)
+            it = m_retiredDmaBufs.erase(it);
+        else
+            ++it;
+    }
+    collectComposeTime();
 
     uint32_t imageIndex;
     vk::Result result =
@@ -189,7 +991,7 @@ void Render::render(int index)
                                       nullptr, &imageIndex);
 
     if (result == vk::Result::eErrorOutOfDateKHR) {
-        recreateSwapChain(index);
+        recreateSwapChain();
         std::cout << "recreating" << std::endl;
         return;
     } else if (result != vk::Result::eSuccess &&
@@ -197,43 +999,71 @@ void Render::render(int index)
         throw std::runtime_error("failed to acquire swap chain image");
     }
 
-    vk::ClearValue clearColor(
-            vk::ClearColorValue(
-                std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f})));
-    updateUniformBuffer(imageIndex);
-
-    vk::PipelineStageFlags waitStages[] =
-        {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-
-    vk::SubmitInfo submitInfo(1, &*m_imageAvailableSemaphores.at(m_currentFrame),
-                              waitStages, 1, &*m_commandBuffers.at(imageIndex),
-                              1, &*m_renderFinishedSemaphores.at(m_currentFrame));
+    updateUniformBuffer(m_currentFrame);
 
-    m_device->resetFences(1, &*m_inFlightFences.at(m_currentFrame));
-
-    result = m_graphicsQueue.submit(1, &submitInfo,
-                                    *m_inFlightFences.at(m_currentFrame));
-    if (result != vk::Result::eSuccess)
-        throw std::runtime_error("failed to submit draw command buffer!");
+    vk::CommandBuffer cmd = *m_commandBuffers.at(m_currentFrame);
+    cmd.begin(vk::CommandBufferBeginInfo(
+                vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    recordPlaceholders(cmd);
+    uint32_t uploaded = recordUploads(cmd);
+    if (isBayer())
+        recordDemosaic(cmd, uploaded);
+
+    // uploads, placeholders and demosaic write what an earlier dispatch on
+    // the compute queue may still read
+    std::array<vk::Semaphore, 2> waits = {
+        *m_imageAvailableSemaphores.at(m_currentFrame), m_composeReads};
+    std::array<vk::PipelineStageFlags, 2> waitStages = {
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eTransfer |
+        vk::PipelineStageFlagBits::eComputeShader};
+    std::array<uint64_t, 2> waitValues = {0, m_composeReadsValue};
+    uint32_t waitCount = m_composeReads ? 2 : 1;
+    m_composeReads = nullptr;
+
+    if (m_view == View::Surround && m_compose == Compose::AsyncCompute) {
+        cmd.end();
+        m_device->resetFences(1, &inFlightFence);
+        submitAsyncCompose(cmd, imageIndex, waitCount - 1, &waits[1],
+                           &waitStages[1], &waitValues[1], inFlightFence);
+    } else {
+        bool compute = m_view == View::Surround &&
+                       m_compose == Compose::Compute;
+        if (compute)
+            recordCompose(cmd, imageIndex);
+        else
+            recordCommandBuffer(cmd, imageIndex);
+        cmd.end();
+
+        // the compute path first touches the swapchain image with its blit
+        if (compute)
+            waitStages[0] = vk::PipelineStageFlagBits::eTransfer;
+
+        m_device->resetFences(1, &inFlightFence);
+
+        uint64_t noValue = 0;
+        submitFrame(m_graphicsQueue, cmd, waitCount, waits.data(),
+                    waitStages.data(), waitValues.data(), 1,
+                    &*m_renderFinishedSemaphores.at(m_currentFrame), &noValue,
+                    inFlightFence);
+    }
 
     vk::PresentInfoKHR
         presentInfo(1, &*m_renderFinishedSemaphores.at(m_currentFrame),
                     1, &*m_swapChain, &imageIndex);
-    result = m_presentQueue.presentKHR(presentInfo);
+    result = m_presentQueue.presentKHR(&presentInfo);
+
+    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
     if (result == vk::Result::eErrorOutOfDateKHR ||
         result == vk::Result::eSuboptimalKHR ||
         framebufferResized) {
         framebufferResized = false;
-        recreateSwapChain(index);
+        recreateSwapChain();
         std::cout << "recreating" << std::endl;
     } else if (result != vk::Result::eSuccess) {
         throw std::runtime_error("failed to present swap chain image!");
     }
-
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-
-    m_device->waitIdle();
 }
 
 bool Render::checkValidationLayerSupport()
@@ -285,6 +1115,20 @@ std::vector<const char*> Render::getRequiredExtension()
     extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 #endif
 
+    // optional, only needed to import camera buffers
+    std::vector<vk::ExtensionProperties> availableExtensions =
+        vk::enumerateInstanceExtensionProperties();
+    std::set<std::string> missing(externalMemoryInstanceExtensions.begin(),
+                                  externalMemoryInstanceExtensions.end());
+    for (const auto& extension : availableExtensions) {
+        missing.erase(extension.extensionName);
+    }
+    if (missing.empty()) {
+        extensions.insert(extensions.end(), externalMemoryInstanceExtensions.begin(),
+                          externalMemoryInstanceExtensions.end());
+        m_externalMemoryCapable = true;
+    }
+
     return extensions;
 }
 
@@ -331,6 +1175,12 @@ void Render::createInstance()
     instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
     m_instance = vk::createInstanceUnique(instanceCreateInfo);
+
+    if (m_externalMemoryCapable) {
+        pfn_vkGetPhysicalDeviceProperties2KHR = (PFN_vkGetPhysicalDeviceProperties2KHR)
+            vkGetInstanceProcAddr(*m_instance, "vkGetPhysicalDeviceProperties2KHR");
+        m_externalMemoryCapable = pfn_vkGetPhysicalDeviceProperties2KHR != nullptr;
+    }
 }
 
 void Render::setupDebugMessage()
@@ -409,12 +1259,18 @@ bool Render::isDeviceSuitable(vk::PhysicalDevice device)
 }
 
 bool Render::checkDeviceExtensionSupport(vk::PhysicalDevice device)
+{
+    return checkDeviceExtensionSupport(device, deviceExtensions);
+}
+
+bool Render::checkDeviceExtensionSupport(vk::PhysicalDevice device,
+                                         const std::vector<const char*>& extensions)
 {
     std::vector<vk::ExtensionProperties> availableExtensions =
         device.enumerateDeviceExtensionProperties();
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                             deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(),
+                                             extensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -430,6 +1286,16 @@ Render::QueueFamilyIndices Render::findQueueFamilies(vk::PhysicalDevice device)
     std::vector<vk::QueueFamilyProperties> queueFamilies =
         device.getQueueFamilyProperties();
 
+    // a family of its own lets composition overlap the graphics queue
+    for (uint32_t j = 0; j < queueFamilies.size(); j++) {
+        if (queueFamilies[j].queueCount > 0 &&
+            queueFamilies[j].queueFlags & vk::QueueFlagBits::eCompute &&
+            !(queueFamilies[j].queueFlags & vk::QueueFlagBits::eGraphics)) {
+            indices.computeFamily = j;
+            break;
+        }
+    }
+
     int i = 0;
     for (const auto &queueFamily : queueFamilies) {
         if (queueFamily.queueCount > 0 &&
@@ -460,6 +1326,8 @@ void Render::createLogicalDevice()
     std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies  = {indices.graphicsFamily,
                                                indices.presentFamily};
+    if (indices.computeFamily != VK_QUEUE_FAMILY_IGNORED)
+        uniqueQueueFamilies.insert(indices.computeFamily);
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -470,6 +1338,43 @@ void Render::createLogicalDevice()
     vk::PhysicalDeviceFeatures deviceFeatures;
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    std::vector<const char*> enabledExtensions(deviceExtensions);
+    if (m_externalMemoryCapable &&
+        checkDeviceExtensionSupport(m_physicalDevice, dmaBufDeviceExtensions)) {
+        enabledExtensions.insert(enabledExtensions.end(),
+                                 dmaBufDeviceExtensions.begin(),
+                                 dmaBufDeviceExtensions.end());
+        m_dmaBufImport = true;
+    }
+    if (m_externalMemoryCapable &&
+        checkDeviceExtensionSupport(m_physicalDevice, hostImportDeviceExtensions)) {
+        enabledExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        if (!m_dmaBufImport) {
+            enabledExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+        }
+
+        vk::PhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties;
+        vk::PhysicalDeviceProperties2 properties;
+        properties.pNext = &hostProperties;
+        m_physicalDevice.getProperties2KHR(&properties);
+        m_importedHostPointerAlignment =
+            hostProperties.minImportedHostPointerAlignment;
+        m_hostImport = true;
+    }
+
+#ifdef VK_KHR_timeline_semaphore
+    // the feature comes with the extension, which needs properties2
+    vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    if (indices.computeFamily != VK_QUEUE_FAMILY_IGNORED &&
+        m_externalMemoryCapable &&
+        checkDeviceExtensionSupport(m_physicalDevice,
+                {VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME})) {
+        enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        m_timelineSemaphores = true;
+    }
+#endif
+
     vk::DeviceCreateInfo
         createInfo({}, static_cast<uint32_t>(queueCreateInfos.size()),
                    queueCreateInfos.data(),
@@ -479,14 +1384,34 @@ void Render::createLogicalDevice()
 #else
                    0, nullptr,
 #endif
-                   static_cast<uint32_t>(deviceExtensions.size()),
-                   deviceExtensions.data(),
+                   static_cast<uint32_t>(enabledExtensions.size()),
+                   enabledExtensions.data(),
                    &deviceFeatures);
+#ifdef VK_KHR_timeline_semaphore
+    if (m_timelineSemaphores)
+        createInfo.pNext = &timelineFeatures;
+#endif
 
     m_device = m_physicalDevice.createDeviceUnique(createInfo);
 
+    if (m_dmaBufImport) {
+        pfn_vkGetMemoryFdPropertiesKHR = (PFN_vkGetMemoryFdPropertiesKHR)
+            vkGetDeviceProcAddr(*m_device, "vkGetMemoryFdPropertiesKHR");
+        m_dmaBufImport = pfn_vkGetMemoryFdPropertiesKHR != nullptr;
+    }
+    if (m_hostImport) {
+        pfn_vkGetMemoryHostPointerPropertiesEXT = (PFN_vkGetMemoryHostPointerPropertiesEXT)
+            vkGetDeviceProcAddr(*m_device, "vkGetMemoryHostPointerPropertiesEXT");
+        m_hostImport = pfn_vkGetMemoryHostPointerPropertiesEXT != nullptr;
+    }
+
     m_graphicsQueue = m_device->getQueue(indices.graphicsFamily, 0);
     m_presentQueue = m_device->getQueue(indices.presentFamily, 0);
+    m_graphicsFamily = indices.graphicsFamily;
+    if (indices.computeFamily != VK_QUEUE_FAMILY_IGNORED) {
+        m_computeFamily = indices.computeFamily;
+        m_computeQueue = m_device->getQueue(indices.computeFamily, 0);
+    }
 }
 
 void Render::createSwapChain()
@@ -506,10 +1431,17 @@ void Render::createSwapChain()
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
 
+    // the compute path blits into the images
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+    m_swapChainTransferDst =
+        static_cast<bool>(swapChainSupport.capabilities.supportedUsageFlags &
+                          vk::ImageUsageFlagBits::eTransferDst);
+    if (m_swapChainTransferDst)
+        usage |= vk::ImageUsageFlagBits::eTransferDst;
+
     vk::SwapchainCreateInfoKHR
         createInfo({}, *m_surface, imageCount, surfaceFormat.format,
-                   surfaceFormat.colorSpace, extent, 1,
-                   vk::ImageUsageFlagBits::eColorAttachment);
+                   surfaceFormat.colorSpace, extent, 1, usage);
 
     QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily,
@@ -634,11 +1566,39 @@ void Render::createDescriptorSetLayout()
             1, vk::DescriptorType::eCombinedImageSampler, 1,
             vk::ShaderStageFlagBits::eFragment);
 
-    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
-        uboLayoutBinding, samplerLayoutBinding};
+    vk::DescriptorSetLayoutBinding chromaLayoutBinding(
+            2, vk::DescriptorType::eCombinedImageSampler, 1,
+            vk::ShaderStageFlagBits::eFragment);
+
+    vk::DescriptorSetLayoutBinding remapLayoutBinding(
+            3, vk::DescriptorType::eCombinedImageSampler, 1,
+            vk::ShaderStageFlagBits::eFragment);
+
+    vk::DescriptorSetLayoutBinding surroundLayoutBinding(
+            4, vk::DescriptorType::eCombinedImageSampler, 1,
+            vk::ShaderStageFlagBits::eFragment);
+
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {
+        uboLayoutBinding, samplerLayoutBinding, chromaLayoutBinding,
+        remapLayoutBinding, surroundLayoutBinding};
 
     m_descriptorSetLayout = m_device->createDescriptorSetLayoutUnique(
-            vk::DescriptorSetLayoutCreateInfo({}, 2, bindings.data()));
+            vk::DescriptorSetLayoutCreateInfo({}, bindings.size(),
+                                              bindings.data()));
+
+    if (isBayer()) {
+        std::array<vk::DescriptorSetLayoutBinding, 2> demosaicBindings = {
+            vk::DescriptorSetLayoutBinding(
+                    0, vk::DescriptorType::eCombinedImageSampler, 1,
+                    vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(
+                    1, vk::DescriptorType::eStorageImage, 1,
+                    vk::ShaderStageFlagBits::eCompute)};
+
+        m_demosaicSetLayout = m_device->createDescriptorSetLayoutUnique(
+                vk::DescriptorSetLayoutCreateInfo({}, demosaicBindings.size(),
+                                                  demosaicBindings.data()));
+    }
 }
 
 void Render::createRenderPass()
@@ -659,8 +1619,16 @@ void Render::createRenderPass()
     vk::SubpassDescription subpass({}, vk::PipelineBindPoint::eGraphics,
                                    0, nullptr, 1, &colorAttachmentRef);
 
+    // the image is only ours once the acquire semaphore signaled, keep the
+    // layout transition behind it now that frames overlap
+    vk::SubpassDependency dependency(
+            VK_SUBPASS_EXTERNAL, 0,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            {}, vk::AccessFlagBits::eColorAttachmentWrite);
+
     vk::RenderPassCreateInfo renderPassInfo({}, 1, &colorAttachment,
-                                            1, &subpass);
+                                            1, &subpass, 1, &dependency);
 
     m_renderPass = m_device->createRenderPassUnique(renderPassInfo);
 }
@@ -680,11 +1648,30 @@ void Render::createGraphicsPipeline()
         throw std::runtime_error("createGraphicsPipeline failed");
     }
 
+    // the fragment shader is specialized for the input format, demosaiced
+    // bayer frames are plain rgb by then, for lens correction and for the
+    // surround view
+    FragConstants fragConstants = {
+        isBayer() ? 0 : static_cast<int32_t>(inputFormat),
+        remapWidth > 0 && !meshWarp, 0};
+    std::array<vk::SpecializationMapEntry, 3> fragEntries = {
+        vk::SpecializationMapEntry(0, offsetof(FragConstants, format),
+                                   sizeof(int32_t)),
+        vk::SpecializationMapEntry(1, offsetof(FragConstants, remap),
+                                   sizeof(int32_t)),
+        vk::SpecializationMapEntry(2, offsetof(FragConstants, surround),
+                                   sizeof(int32_t))};
+    vk::SpecializationInfo fragSpecialization(fragEntries.size(),
+                                              fragEntries.data(),
+                                              sizeof(fragConstants),
+                                              &fragConstants);
+
     vk::PipelineShaderStageCreateInfo shaderStages[2] = {
         vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex,
                                           *vertShaderModule, "main"),
         vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment,
-                                          *fragShaderModule, "main")};
+                                          *fragShaderModule, "main",
+                                          &fragSpecialization)};
 
     auto bindingDescription = Vertex::getBindingDescription();
     auto attributeDescriptions = Vertex::getAttributeDescriptions();
@@ -694,7 +1681,7 @@ void Render::createGraphicsPipeline()
                         attributeDescriptions.data());
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssembly(
-            {}, vk::PrimitiveTopology::eTriangleStrip);
+            {}, vk::PrimitiveTopology::eTriangleList);
 
     vk::Viewport viewport(0.0f, 0.0f, (float)m_swapChainExtent.width,
                           (float)m_swapChainExtent.height, 0.0f, 1.0f);
@@ -732,10 +1719,259 @@ void Render::createGraphicsPipeline()
 
     m_graphicsPipeline = m_device->createGraphicsPipelineUnique(nullptr,
                                                                 pipelineInfo);
-}
 
-std::vector<char> Render::readFile(const std::string& filename)
-{
+    if (!hasSurround())
+        return;
+
+    FragConstants surroundConstants = fragConstants;
+    surroundConstants.remap = 0;
+    surroundConstants.surround = 1;
+    vk::SpecializationInfo surroundSpecialization(fragEntries.size(),
+                                                  fragEntries.data(),
+                                                  sizeof(surroundConstants),
+                                                  &surroundConstants);
+    shaderStages[1].pSpecializationInfo = &surroundSpecialization;
+
+    m_surroundPipeline = m_device->createGraphicsPipelineUnique(nullptr,
+                                                                pipelineInfo);
+}
+
+void Render::createDemosaicPipeline()
+{
+    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+    std::vector<vk::QueueFamilyProperties> queueFamilies =
+        m_physicalDevice.getQueueFamilyProperties();
+    if (!(queueFamilies.at(indices.graphicsFamily).queueFlags &
+          vk::QueueFlagBits::eCompute)) {
+        throw std::runtime_error("graphics queue can not run the demosaic pass");
+    }
+
+    auto compShaderCode = readFile("demosaic.comp.spv");
+    if (compShaderCode.size() == 0) {
+        throw std::runtime_error("createDemosaicPipeline failed");
+    }
+    vk::UniqueShaderModule compShaderModule = createShaderModule(compShaderCode);
+
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute,
+                                            0, sizeof(DemosaicConstants));
+    m_demosaicPipelineLayout = m_device->createPipelineLayoutUnique(
+            vk::PipelineLayoutCreateInfo({}, 1, &*m_demosaicSetLayout,
+                                         1, &pushConstantRange));
+
+    vk::ComputePipelineCreateInfo pipelineInfo(
+            {}, vk::PipelineShaderStageCreateInfo(
+                    {}, vk::ShaderStageFlagBits::eCompute,
+                    *compShaderModule, "main"),
+            *m_demosaicPipelineLayout);
+
+    m_demosaicPipeline = m_device->createComputePipelineUnique(nullptr,
+                                                               pipelineInfo);
+}
+
+/*
+ * only where the graphics queue computes, the output can be a storage
+ * image and it can be blitted into the swapchain. The raster path is left
+ * otherwise
+ */
+void Render::createComposePipeline()
+{
+    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+    std::vector<vk::QueueFamilyProperties> queueFamilies =
+        m_physicalDevice.getQueueFamilyProperties();
+    vk::FormatFeatureFlags outFeatures =
+        m_physicalDevice.getFormatProperties(vk::Format::eR8G8B8A8Unorm)
+            .optimalTilingFeatures;
+    vk::FormatFeatureFlags swapChainFeatures =
+        m_physicalDevice.getFormatProperties(m_swapChainImageFormat)
+            .optimalTilingFeatures;
+    if (!(queueFamilies.at(indices.graphicsFamily).queueFlags &
+          vk::QueueFlagBits::eCompute) ||
+        !(outFeatures & vk::FormatFeatureFlagBits::eStorageImage) ||
+        !(outFeatures & vk::FormatFeatureFlagBits::eBlitSrc) ||
+        !(swapChainFeatures & vk::FormatFeatureFlagBits::eBlitDst) ||
+        !m_swapChainTransferDst) {
+        return;
+    }
+
+    auto compShaderCode = readFile("compose.comp.spv");
+    if (compShaderCode.size() == 0) {
+        throw std::runtime_error("createComposePipeline failed");
+    }
+    m_composeShader = createShaderModule(compShaderCode);
+
+    // the samplers are bound where shader.frag has them
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings = {
+        vk::DescriptorSetLayoutBinding(
+                0, vk::DescriptorType::eStorageImage, 1,
+                vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+                1, vk::DescriptorType::eCombinedImageSampler, 1,
+                vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+                2, vk::DescriptorType::eCombinedImageSampler, 1,
+                vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+                4, vk::DescriptorType::eCombinedImageSampler, 1,
+                vk::ShaderStageFlagBits::eCompute)};
+    m_composeSetLayout = m_device->createDescriptorSetLayoutUnique(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings.size(),
+                                              bindings.data()));
+
+    vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute,
+                                            0, sizeof(ComposeConstants));
+    m_composePipelineLayout = m_device->createPipelineLayoutUnique(
+            vk::PipelineLayoutCreateInfo({}, 1, &*m_composeSetLayout,
+                                         1, &pushConstantRange));
+
+    // a workgroup asked for beyond the limits falls back to the default
+    if (!supportsComposeGroup(m_composeGroup)) {
+        std::cerr << "compose workgroup " << m_composeGroup.width << "x"
+                  << m_composeGroup.height << " exceeds the device limits"
+                  << std::endl;
+        m_composeGroup = ComposeGroup();
+    }
+    m_composePipeline = createComposeVariant(m_composeGroup);
+}
+
+vk::UniquePipeline Render::createComposeVariant(const ComposeGroup& group)
+{
+    // demosaiced bayer frames are plain rgb
+    ComposeSpecialization constants = {
+        isBayer() ? 0 : static_cast<int32_t>(inputFormat),
+        group.width, group.height};
+    std::array<vk::SpecializationMapEntry, 3> entries = {
+        vk::SpecializationMapEntry(0, offsetof(ComposeSpecialization, format),
+                                   sizeof(int32_t)),
+        vk::SpecializationMapEntry(1, offsetof(ComposeSpecialization,
+                                               groupWidth),
+                                   sizeof(uint32_t)),
+        vk::SpecializationMapEntry(2, offsetof(ComposeSpecialization,
+                                               groupHeight),
+                                   sizeof(uint32_t))};
+    vk::SpecializationInfo specialization(entries.size(), entries.data(),
+                                          sizeof(constants), &constants);
+
+    vk::ComputePipelineCreateInfo pipelineInfo(
+            {}, vk::PipelineShaderStageCreateInfo(
+                    {}, vk::ShaderStageFlagBits::eCompute,
+                    *m_composeShader, "main", &specialization),
+            *m_composePipelineLayout);
+
+    return m_device->createComputePipelineUnique(nullptr, pipelineInfo);
+}
+
+bool Render::supportsComposeGroup(const ComposeGroup& group) const
+{
+    const vk::PhysicalDeviceLimits& limits =
+        m_physicalDevice.getProperties().limits;
+
+    return group.width > 0 && group.height > 0 &&
+           group.width <= limits.maxComputeWorkGroupSize[0] &&
+           group.height <= limits.maxComputeWorkGroupSize[1] &&
+           group.width * group.height <= limits.maxComputeWorkGroupInvocations;
+}
+
+void Render::setComposeGroup(const ComposeGroup& group)
+{
+    if (!m_composeShader) {
+        m_composeGroup = group;
+        return;
+    }
+    if (!supportsComposeGroup(group) ||
+        (group.width == m_composeGroup.width &&
+         group.height == m_composeGroup.height))
+        return;
+
+    // recorded frames still in flight use the old pipeline
+    m_device->waitIdle();
+    m_composePipeline = createComposeVariant(group);
+    m_composeGroup = group;
+}
+
+/*
+ * the swapchain's size, so they are made again along with the swapchain.
+ * Exclusive to one family at a time, AsyncCompute hands each frame's image
+ * over to the graphics queue for the blit
+ */
+void Render::createComposeImage()
+{
+    if (!m_composePipeline)
+        return;
+
+    m_ucomposeImageViews.clear();
+    m_ucomposeImages.clear();
+    m_ucomposeMems.clear();
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vk::UniqueImage image = m_device->createImageUnique(
+                vk::ImageCreateInfo({}, vk::ImageType::e2D,
+                    vk::Format::eR8G8B8A8Unorm,
+                    vk::Extent3D(m_swapChainExtent.width,
+                                 m_swapChainExtent.height, 1),
+                    1, 1, vk::SampleCountFlagBits::e1,
+                    vk::ImageTiling::eOptimal,
+                    vk::ImageUsageFlagBits::eStorage |
+                    vk::ImageUsageFlagBits::eTransferSrc,
+                    vk::SharingMode::eExclusive,
+                    0, nullptr, vk::ImageLayout::eUndefined));
+
+        vk::MemoryRequirements memoryRequirements =
+            m_device->getImageMemoryRequirements(*image);
+        uint32_t memoryTypeIndex =
+            findMemoryType(memoryRequirements.memoryTypeBits,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal);
+        vk::UniqueDeviceMemory memory = m_device->allocateMemoryUnique(
+                vk::MemoryAllocateInfo(memoryRequirements.size,
+                                       memoryTypeIndex));
+        m_device->bindImageMemory(*image, *memory, 0);
+
+        vk::UniqueImageView imageView = m_device->createImageViewUnique(
+                vk::ImageViewCreateInfo({}, *image,
+                    vk::ImageViewType::e2D,
+                    vk::Format::eR8G8B8A8Unorm, {},
+                    vk::ImageSubresourceRange(
+                        vk::ImageAspectFlagBits::eColor,
+                        0, 1, 0, 1)));
+
+        vk::DescriptorImageInfo outInfo({}, *imageView,
+                                        vk::ImageLayout::eGeneral);
+        vk::WriteDescriptorSet outWrite(*m_composeSets.at(i), 0, 0, 1,
+                                        vk::DescriptorType::eStorageImage,
+                                        &outInfo, nullptr);
+        m_device->updateDescriptorSets(outWrite, {});
+
+        m_ucomposeImages.push_back(std::move(image));
+        m_ucomposeMems.push_back(std::move(memory));
+        m_ucomposeImageViews.push_back(std::move(imageView));
+    }
+}
+
+// without timestamps on the graphics queue nothing is measured, without
+// them on the compute queue AsyncCompute is not
+void Render::createTimestampPool()
+{
+    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+    std::vector<vk::QueueFamilyProperties> queueFamilies =
+        m_physicalDevice.getQueueFamilyProperties();
+    uint32_t validBits =
+        queueFamilies.at(indices.graphicsFamily).timestampValidBits;
+    if (!validBits)
+        return;
+
+    m_timestampPeriod = m_physicalDevice.getProperties().limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+    if (supportsAsyncCompose()) {
+        uint32_t computeBits = queueFamilies.at(m_computeFamily).timestampValidBits;
+        m_computeTimestampMask = computeBits >= 64 ? ~0ULL :
+                                 (1ULL << computeBits) - 1;
+    }
+    m_timestampPool = m_device->createQueryPoolUnique(
+            vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp,
+                                    2 * MAX_FRAMES_IN_FLIGHT));
+    m_timedCompose.assign(MAX_FRAMES_IN_FLIGHT, -1);
+}
+
+std::vector<char> Render::readFile(const std::string& filename)
+{
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
         return std::vector<char>();
@@ -785,6 +2021,13 @@ void Render::createCommandPool()
     m_commandPool = m_device->createCommandPoolUnique(
             vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
 									  queueFamilyIndices.graphicsFamily));
+
+    if (supportsAsyncCompose()) {
+        m_computeCommandPool = m_device->createCommandPoolUnique(
+                vk::CommandPoolCreateInfo(
+                    vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                    m_computeFamily));
+    }
 }
 
 void Render::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout,
@@ -839,7 +2082,7 @@ void Render::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout,
 
     vk::ImageSubresourceRange
         imageSubresourceRange(vk::ImageAspectFlagBits::eColor,
-                              0, 1, 0, 4); //TODO layer count dyn
+                              0, 1, 0, VK_REMAINING_ARRAY_LAYERS);
     vk::ImageMemoryBarrier imageMemoryBarrier(srcAccessMask, dstAccessMask,
                                               oldLayout, newLayout,
                                               VK_QUEUE_FAMILY_IGNORED,
@@ -857,16 +2100,339 @@ void Render::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout,
 
 void Render::createTextureImage()
 {
-    if (textureWidth <= 0 || textureHeight <= 0 || pixelSize <= 0 ||
+    if (textureWidth <= 0 || textureHeight <= 0 ||
         camNum <= 0 || camBufNum <= 2) {
         throw std::runtime_error("invalid texture format!");
     }
 
-    int frameSize = textureWidth * textureHeight * pixelSize;
+    // chroma is subsampled horizontally, and for NV12 vertically too
+    if ((inputFormat != InputFormat::XBGR32 && textureWidth % 2) ||
+        (inputFormat == InputFormat::NV12 && textureHeight % 2)) {
+        throw std::runtime_error("frame size does not fit the input format");
+    }
+
+    // copies start at a multiple of 4 bytes, NV12 frames need not be one
+    vk::DeviceSize frameSize = getFrameSize();
+    vk::DeviceSize frameStride = (frameSize + 255) / 256 * 256;
+    vk::DeviceSize stageSize = frameStride * camNum * camBufNum;
     m_stageMemMaps.resize(camNum);
 
+    void *data = nullptr;
+    if (m_stagingMode == StagingMode::HostImport) {
+        try {
+            data = createImportedStageBuffer(stageSize);
+        } catch (const std::exception& e) {
+            std::cout << "host memory import unavailable, " << e.what()
+                      << std::endl;
+            m_stagingMode = StagingMode::HostCoherent;
+        }
+    }
+    if (!data) {
+        data = createMappedStageBuffer(stageSize);
+    }
+
+    m_stageRegions.resize(camNum);
+
+    for (int i = 0; i < camNum; i++) {
+        for (int j = 0; j < camBufNum; j++) {
+            m_stageMemMaps[i].push_back(PixelBufferBase(data, frameSize, textureWidth, textureHeight, i, j));
+            m_stageRegions[i].push_back(
+                    StageRegion{*m_uStageBuffer,
+                                frameStride * (i * camBufNum + j)});
+            data = static_cast<char*>(data) + frameStride;
+        }
+    }
+
+    vk::ImageUsageFlags uploadUsage = vk::ImageUsageFlagBits::eSampled |
+                                      vk::ImageUsageFlagBits::eTransferDst;
+    vk::Extent3D extent = getTextureExtent();
+    m_utextureImage = createTextureArray(getTextureFormat(), extent.width,
+                                         extent.height, uploadUsage,
+                                         vk::ImageLayout::eShaderReadOnlyOptimal,
+                                         m_utextureMem);
+    if (inputFormat == InputFormat::NV12) {
+        m_uchromaImage = createTextureArray(vk::Format::eR8G8Unorm,
+                                            textureWidth / 2,
+                                            textureHeight / 2, uploadUsage,
+                                            vk::ImageLayout::eShaderReadOnlyOptimal,
+                                            m_uchromaMem);
+    }
+
+    // written by the demosaic pass and sampled by the draw, so it stays in
+    // the general layout
+    if (isBayer()) {
+        m_udemosaicImage = createTextureArray(vk::Format::eR8G8B8A8Unorm,
+                                              textureWidth, textureHeight,
+                                              vk::ImageUsageFlagBits::eSampled |
+                                              vk::ImageUsageFlagBits::eStorage |
+                                              vk::ImageUsageFlagBits::eTransferDst,
+                                              vk::ImageLayout::eGeneral,
+                                              m_udemosaicMem);
+    }
+}
+
+/*
+ * the remap tables are uploaded once through a staging buffer that is
+ * dropped again. They are sampled with filtering where the device can
+ * filter 32 bit floats, otherwise the nearest entry is used. A warp mesh
+ * takes them into its vertices instead
+ */
+void Render::createRemapImage()
+{
+    if (m_remapTables.empty())
+        return;
+
+    vk::DeviceSize tableSize = static_cast<vk::DeviceSize>(remapWidth) *
+                               remapHeight * 2 * sizeof(float);
+    if (remapWidth <= 0 || remapHeight <= 0 ||
+        m_remapTables.size() != static_cast<size_t>(camNum)) {
+        throw std::runtime_error("invalid remap tables");
+    }
+    for (const auto& table : m_remapTables) {
+        if (table.size() * sizeof(float) != tableSize) {
+            throw std::runtime_error("invalid remap tables");
+        }
+    }
+    if (meshWarp)
+        return;
+
+    m_uremapImage = createTableImage(vk::Format::eR32G32Sfloat, remapWidth,
+                                     remapHeight, m_remapTables, m_uremapMem);
+    // not needed on the cpu any more
+    m_remapTables.clear();
+    m_remapTables.shrink_to_fit();
+
+    m_uremapImageView = m_device->createImageViewUnique(
+            vk::ImageViewCreateInfo({}, *m_uremapImage,
+                vk::ImageViewType::e2DArray,
+                vk::Format::eR32G32Sfloat, {},
+                vk::ImageSubresourceRange(
+                    vk::ImageAspectFlagBits::eColor,
+                    0, 1, 0, camNum)));
+
+    vk::FormatProperties props =
+        m_physicalDevice.getFormatProperties(vk::Format::eR32G32Sfloat);
+    vk::Filter filter =
+        props.optimalTilingFeatures &
+            vk::FormatFeatureFlagBits::eSampledImageFilterLinear ?
+        vk::Filter::eLinear : vk::Filter::eNearest;
+    m_uremapSampler = m_device->createSamplerUnique(
+            vk::SamplerCreateInfo({}, filter, filter,
+                                  vk::SamplerMipmapMode::eNearest,
+                                  vk::SamplerAddressMode::eClampToEdge,
+                                  vk::SamplerAddressMode::eClampToEdge,
+                                  vk::SamplerAddressMode::eClampToEdge));
+}
+
+/*
+ * the surround view's two layers are only ever fetched texel by texel, a
+ * camera index can not be filtered
+ */
+void Render::createSurroundImage()
+{
+    if (!hasSurround())
+        return;
+
+    vk::DeviceSize layerSize = static_cast<vk::DeviceSize>(surroundWidth) *
+                               surroundHeight * 4;
+    if (surroundHeight <= 0 || m_surroundTables.size() != 2 ||
+        m_surroundTables[0].size() != layerSize ||
+        m_surroundTables[1].size() != layerSize) {
+        throw std::runtime_error("invalid surround table");
+    }
+
+    m_usurroundImage = createTableImage(vk::Format::eR32G32B32A32Sfloat,
+                                        surroundWidth, surroundHeight,
+                                        m_surroundTables, m_usurroundMem);
+    m_surroundTables.clear();
+    m_surroundTables.shrink_to_fit();
+
+    m_usurroundImageView = m_device->createImageViewUnique(
+            vk::ImageViewCreateInfo({}, *m_usurroundImage,
+                vk::ImageViewType::e2DArray,
+                vk::Format::eR32G32B32A32Sfloat, {},
+                vk::ImageSubresourceRange(
+                    vk::ImageAspectFlagBits::eColor,
+                    0, 1, 0, 2)));
+
+    m_usurroundSampler = m_device->createSamplerUnique(
+            vk::SamplerCreateInfo({}, vk::Filter::eNearest,
+                                  vk::Filter::eNearest,
+                                  vk::SamplerMipmapMode::eNearest,
+                                  vk::SamplerAddressMode::eClampToEdge,
+                                  vk::SamplerAddressMode::eClampToEdge,
+                                  vk::SamplerAddressMode::eClampToEdge));
+}
+
+// a layer per table, uploaded through a staging buffer that is dropped again
+vk::UniqueImage Render::createTableImage(
+        vk::Format format, int width, int height,
+        const std::vector<std::vector<float>>& layers,
+        vk::UniqueDeviceMemory& memory)
+{
+    uint32_t layerNum = layers.size();
+    vk::DeviceSize layerSize = layers.at(0).size() * sizeof(float);
+
+    vk::UniqueBuffer stageBuffer = m_device->createBufferUnique(
+            vk::BufferCreateInfo({}, layerSize * layerNum,
+                                 vk::BufferUsageFlagBits::eTransferSrc));
+    vk::MemoryRequirements memRequirements =
+        m_device->getBufferMemoryRequirements(*stageBuffer);
+    uint32_t memoryTypeIndex =
+        findMemoryType(memRequirements.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eHostVisible |
+                       vk::MemoryPropertyFlagBits::eHostCoherent);
+    vk::UniqueDeviceMemory stageMem = m_device->allocateMemoryUnique(
+            vk::MemoryAllocateInfo(memRequirements.size, memoryTypeIndex));
+    m_device->bindBufferMemory(*stageBuffer, *stageMem, 0);
+
+    char* data = static_cast<char*>(
+            m_device->mapMemory(*stageMem, 0, layerSize * layerNum));
+    for (uint32_t i = 0; i < layerNum; i++) {
+        memcpy(data + layerSize * i, layers[i].data(), layerSize);
+    }
+    m_device->unmapMemory(*stageMem);
+
+    vk::UniqueImage image = createTextureArray(format, width, height,
+                                               vk::ImageUsageFlagBits::eSampled |
+                                               vk::ImageUsageFlagBits::eTransferDst,
+                                               vk::ImageLayout::eShaderReadOnlyOptimal,
+                                               memory, layerNum);
+
+    std::vector<vk::UniqueCommandBuffer> cmds =
+        m_device->allocateCommandBuffersUnique(
+                vk::CommandBufferAllocateInfo(*m_commandPool,
+                                              vk::CommandBufferLevel::ePrimary,
+                                              1));
+    vk::CommandBuffer cmd = *cmds[0];
+    cmd.begin(vk::CommandBufferBeginInfo(
+                vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    vk::ImageMemoryBarrier barrier({}, vk::AccessFlagBits::eTransferWrite,
+                                   vk::ImageLayout::eShaderReadOnlyOptimal,
+                                   vk::ImageLayout::eTransferDstOptimal,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   *image,
+                                   vk::ImageSubresourceRange(
+                                       vk::ImageAspectFlagBits::eColor,
+                                       0, 1, 0, layerNum));
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                        vk::PipelineStageFlagBits::eTransfer, {},
+                        nullptr, nullptr, barrier);
+    cmd.copyBufferToImage(*stageBuffer, *image,
+                          vk::ImageLayout::eTransferDstOptimal,
+                          vk::BufferImageCopy(0, 0, 0,
+                              vk::ImageSubresourceLayers(
+                                  vk::ImageAspectFlagBits::eColor, 0, 0,
+                                  layerNum),
+                              vk::Offset3D(0, 0, 0),
+                              vk::Extent3D(width, height, 1)));
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eFragmentShader, {},
+                        nullptr, nullptr, barrier);
+    cmd.end();
+
+    m_graphicsQueue.submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &cmd), {});
+    m_graphicsQueue.waitIdle();
+
+    return image;
+}
+
+vk::UniqueImage Render::createTextureArray(vk::Format format, uint32_t width,
+                                           uint32_t height,
+                                           vk::ImageUsageFlags usage,
+                                           vk::ImageLayout layout,
+                                           vk::UniqueDeviceMemory& memory,
+                                           uint32_t layers)
+{
+    // sampled by AsyncCompute on the compute queue as well, sharing them
+    // saves handing every uploaded layer back and forth
+    std::array<uint32_t, 2> families = {m_graphicsFamily, m_computeFamily};
+    bool concurrent = supportsAsyncCompose();
+
+    vk::UniqueImage image = m_device->createImageUnique(
+            vk::ImageCreateInfo({}, vk::ImageType::e2D, format,
+                vk::Extent3D(width, height, 1),
+                1, layers ? layers : camNum, vk::SampleCountFlagBits::e1,
+                vk::ImageTiling::eOptimal, usage,
+                concurrent ? vk::SharingMode::eConcurrent :
+                             vk::SharingMode::eExclusive,
+                concurrent ? families.size() : 0,
+                concurrent ? families.data() : nullptr,
+                vk::ImageLayout::eUndefined));
+
+    vk::MemoryRequirements memoryRequirements =
+        m_device->getImageMemoryRequirements(*image);
+    uint32_t memoryTypeIndex =
+        findMemoryType(memoryRequirements.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal);
+    memory = m_device->allocateMemoryUnique(
+            vk::MemoryAllocateInfo(memoryRequirements.size, memoryTypeIndex));
+    m_device->bindImageMemory(*image, *memory, 0);
+
+    // uploads only ever move single layers between transfer and shader
+    // layouts, so give every layer a defined starting point once
+    transitionImageLayout(*image, vk::ImageLayout::eUndefined, layout,
+                          vk::PipelineStageFlagBits::eTopOfPipe,
+                          vk::PipelineStageFlagBits::eFragmentShader |
+                          vk::PipelineStageFlagBits::eComputeShader);
+
+    return image;
+}
+
+vk::DeviceSize Render::getFrameSize() const
+{
+    vk::DeviceSize pixels = static_cast<vk::DeviceSize>(textureWidth) *
+                            textureHeight;
+
+    switch (inputFormat) {
+    case InputFormat::YUYV:
+        return pixels * 2;
+    case InputFormat::NV12:
+        return pixels * 3 / 2;
+    case InputFormat::Bayer10:
+    case InputFormat::Bayer12:
+        return pixels * 2;
+    case InputFormat::XBGR32:
+    default:
+        return pixels * 4;
+    }
+}
+
+vk::Format Render::getTextureFormat() const
+{
+    switch (inputFormat) {
+    case InputFormat::YUYV:
+        return vk::Format::eR8G8B8A8Unorm;
+    case InputFormat::NV12:
+        return vk::Format::eR8Unorm;
+    case InputFormat::Bayer10:
+    case InputFormat::Bayer12:
+        return vk::Format::eR16Uint;
+    case InputFormat::XBGR32:
+    default:
+        return vk::Format::eB8G8R8A8Unorm;
+    }
+}
+
+// YUYV keeps two pixels in one rgba texel
+vk::Extent3D Render::getTextureExtent() const
+{
+    uint32_t width = inputFormat == InputFormat::YUYV ? textureWidth / 2 :
+                                                        textureWidth;
+
+    return vk::Extent3D(width, textureHeight, 1);
+}
+
+void* Render::createMappedStageBuffer(vk::DeviceSize size)
+{
     m_uStageBuffer = m_device->createBufferUnique(
-            vk::BufferCreateInfo({}, frameSize * camNum * camBufNum,
+            vk::BufferCreateInfo({}, size,
                 vk::BufferUsageFlagBits::eTransferSrc));
     vk::MemoryRequirements stageMemReq = m_device->getBufferMemoryRequirements(*m_uStageBuffer);
     uint32_t stageMemTypeIndex =
@@ -877,33 +2443,61 @@ void Render::createTextureImage()
             vk::MemoryAllocateInfo(stageMemReq.size, stageMemTypeIndex));
     m_device->bindBufferMemory(*m_uStageBuffer, *m_uStageMem, 0);
 
-    void *data = m_device->mapMemory(*m_uStageMem, 0, frameSize * camNum * camBufNum);
-    for (int i = 0; i < camNum; i++) {
-        for (int j = 0; j < camBufNum; j++) {
-            m_stageMemMaps[i].push_back(PixelBufferBase(data, frameSize, textureWidth, textureHeight, i, j));
-            data = static_cast<char*>(data) + frameSize;
-        }
+    return m_device->mapMemory(*m_uStageMem, 0, size);
+}
+
+void* Render::createImportedStageBuffer(vk::DeviceSize size)
+{
+    if (!m_hostImport) {
+        throw std::runtime_error("VK_EXT_external_memory_host not supported");
     }
 
-    m_utextureImage = m_device->createImageUnique(
-            vk::ImageCreateInfo({}, vk::ImageType::e2D,
-                vk::Format::eB8G8R8A8Unorm,
-                vk::Extent3D(textureWidth, textureHeight, 1),
-                1, camNum, vk::SampleCountFlagBits::e1, // TODO layout number dynamic
-                vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eSampled |
-                vk::ImageUsageFlagBits::eTransferDst,
-                vk::SharingMode::eExclusive,
-                0, nullptr, vk::ImageLayout::eUndefined));
+    // both the pointer and the size of an import have to be multiples of
+    // minImportedHostPointerAlignment
+    vk::DeviceSize alignment = std::max<vk::DeviceSize>(
+            m_importedHostPointerAlignment, sysconf(_SC_PAGESIZE));
+    size = (size + alignment - 1) / alignment * alignment;
 
-    vk::MemoryRequirements memoryRequirements =
-        m_device->getImageMemoryRequirements(*m_utextureImage);
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size)) {
+        throw std::runtime_error("failed to allocate host staging memory");
+    }
+    std::unique_ptr<void, decltype(&free)> hostMem(ptr, &free);
+
+    vk::MemoryHostPointerPropertiesEXT hostProperties =
+        m_device->getMemoryHostPointerPropertiesEXT(
+                vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, ptr);
+
+    vk::ExternalMemoryBufferCreateInfo externalInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT);
+    vk::BufferCreateInfo bufferInfo({}, size,
+                                    vk::BufferUsageFlagBits::eTransferSrc);
+    bufferInfo.pNext = &externalInfo;
+    vk::UniqueBuffer buffer = m_device->createBufferUnique(bufferInfo);
+
+    vk::MemoryRequirements memRequirements =
+        m_device->getBufferMemoryRequirements(*buffer);
+    if (memRequirements.size > size) {
+        throw std::runtime_error("staging buffer larger than host allocation");
+    }
     uint32_t memoryTypeIndex =
-        findMemoryType(memoryRequirements.memoryTypeBits,
-                vk::MemoryPropertyFlagBits::eDeviceLocal);
-    m_utextureMem = m_device->allocateMemoryUnique(
-            vk::MemoryAllocateInfo(memoryRequirements.size, memoryTypeIndex));
-    m_device->bindImageMemory(*m_utextureImage, *m_utextureMem, 0);
+        findMemoryType(memRequirements.memoryTypeBits &
+                       hostProperties.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eHostVisible |
+                       vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    vk::ImportMemoryHostPointerInfoEXT importInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, ptr);
+    vk::MemoryAllocateInfo allocInfo(size, memoryTypeIndex);
+    allocInfo.pNext = &importInfo;
+    vk::UniqueDeviceMemory memory = m_device->allocateMemoryUnique(allocInfo);
+    m_device->bindBufferMemory(*buffer, *memory, 0);
+
+    m_hostStageMem = std::move(hostMem);
+    m_uStageBuffer = std::move(buffer);
+    m_uStageMem = std::move(memory);
+
+    return ptr;
 }
 
 void Render::createTextureImageView()
@@ -911,10 +2505,30 @@ void Render::createTextureImageView()
     m_utextureImageView = m_device->createImageViewUnique(
             vk::ImageViewCreateInfo({}, *m_utextureImage,
                 vk::ImageViewType::e2DArray,
-                vk::Format::eB8G8R8A8Unorm, {},
+                getTextureFormat(), {},
                 vk::ImageSubresourceRange(
                     vk::ImageAspectFlagBits::eColor,
-                    0, 1, 0, 4)));
+                    0, 1, 0, camNum)));
+
+    if (m_udemosaicImage) {
+        m_udemosaicImageView = m_device->createImageViewUnique(
+                vk::ImageViewCreateInfo({}, *m_udemosaicImage,
+                    vk::ImageViewType::e2DArray,
+                    vk::Format::eR8G8B8A8Unorm, {},
+                    vk::ImageSubresourceRange(
+                        vk::ImageAspectFlagBits::eColor,
+                        0, 1, 0, camNum)));
+    }
+
+    if (m_uchromaImage) {
+        m_uchromaImageView = m_device->createImageViewUnique(
+                vk::ImageViewCreateInfo({}, *m_uchromaImage,
+                    vk::ImageViewType::e2DArray,
+                    vk::Format::eR8G8Unorm, {},
+                    vk::ImageSubresourceRange(
+                        vk::ImageAspectFlagBits::eColor,
+                        0, 1, 0, camNum)));
+    }
 }
 
 void Render::createTextureSampler()
@@ -927,11 +2541,165 @@ void Render::createTextureSampler()
                                   vk::SamplerAddressMode::eClampToBorder,
                                   0, VK_TRUE, 16, VK_FALSE,
                                   vk::CompareOp::eAlways));
+
+    // integer raw samples are only fetched, never filtered
+    if (isBayer()) {
+        m_urawSampler = m_device->createSamplerUnique(
+                vk::SamplerCreateInfo({}, vk::Filter::eNearest,
+                                      vk::Filter::eNearest,
+                                      vk::SamplerMipmapMode::eNearest,
+                                      vk::SamplerAddressMode::eClampToEdge,
+                                      vk::SamplerAddressMode::eClampToEdge,
+                                      vk::SamplerAddressMode::eClampToEdge));
+    }
+}
+
+/*
+ * a mesh per camera and view, mirrored horizontally. The grid view puts
+ * every camera into a cell of two columns, the strip view puts them side
+ * by side at the aspect of the view. A mesh shows the whole sensor, so a
+ * cropped frame sits where it was taken from and texture coordinates
+ * outside it are drawn black. The surround view comes last, a single mesh
+ * over its table
+ */
+std::vector<Render::MeshCell> Render::layoutMeshes() const
+{
+    float sensorW = sensorWidth > 0 ? sensorWidth : textureWidth;
+    float sensorH = sensorHeight > 0 ? sensorHeight : textureHeight;
+
+    // texture coordinates of the sensor's edges, the left edge of a cell
+    // shows the right edge of the sensor
+    float uLeft = (sensorW - cropLeft) / textureWidth;
+    float uRight = -static_cast<float>(cropLeft) / textureWidth;
+    float vTop = -static_cast<float>(cropTop) / textureHeight;
+    float vBottom = (sensorH - cropTop) / textureHeight;
+
+    // remap tables cover the view and map into the frame themselves, either
+    // per pixel or at the vertices
+    bool baked = remapWidth > 0 && meshWarp;
+    if (remapWidth > 0) {
+        uLeft = 1.0f;
+        uRight = 0.0f;
+        vTop = 0.0f;
+        vBottom = 1.0f;
+    }
+
+    std::vector<MeshCell> cells;
+    glm::vec2 topLeft(uLeft, vTop);
+    glm::vec2 bottomRight(uRight, vBottom);
+
+    int cols = camNum > 1 ? 2 : 1;
+    int rows = (camNum + cols - 1) / cols;
+    float cellW = 2.0f / cols;
+    float cellH = 2.0f / rows;
+    for (int i = 0; i < camNum; i++) {
+        cells.push_back({-1.0f + (i % cols) * cellW,
+                         -1.0f + (i / cols) * cellH, cellW, cellH,
+                         topLeft, bottomRight, baked ? i : -1});
+    }
+
+    // the strip and the surround view fit the window, they are laid out
+    // again when it is resized
+    float windowAspect = static_cast<float>(m_swapChainExtent.width) /
+                         m_swapChainExtent.height;
+    auto fit = [&](float viewAspect, float width)
+    {
+        float height = width * windowAspect / viewAspect;
+        if (height > 2.0f) {
+            width *= 2.0f / height;
+            height = 2.0f;
+        }
+        return glm::vec2(width, height);
+    };
+
+    glm::vec2 strip = fit(remapWidth > 0 ?
+        static_cast<float>(remapWidth) / remapHeight : sensorW / sensorH,
+        2.0f / camNum);
+    for (int i = 0; i < camNum; i++) {
+        cells.push_back({-strip.x * camNum / 2 + i * strip.x, -strip.y / 2,
+                         strip.x, strip.y, topLeft, bottomRight,
+                         baked ? i : -1});
+    }
+
+    if (hasSurround()) {
+        glm::vec2 top = fit(static_cast<float>(surroundWidth) / surroundHeight,
+                            2.0f);
+        cells.push_back({-top.x / 2, -top.y / 2, top.x, top.y,
+                         glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), -1});
+    }
+
+    return cells;
+}
+
+// meshDensity * meshDensity cells per mesh
+void Render::createVertices()
+{
+    // the vertices of a mesh have to be reachable by 16 bit indices
+    if (meshDensity < 1 || meshDensity > 255)
+        throw std::runtime_error("invalid warp mesh density");
+
+    bool baked = remapWidth > 0 && meshWarp;
+    std::vector<MeshCell> cells = layoutMeshes();
+    int n = meshDensity;
+    m_vertices.clear();
+    m_vertices.reserve(cells.size() * (n + 1) * (n + 1));
+    for (const MeshCell& cell : cells) {
+        glm::vec2 texSize = cell.bottomRight - cell.topLeft;
+
+        for (int gy = 0; gy <= n; gy++) {
+            float fy = static_cast<float>(gy) / n;
+            for (int gx = 0; gx <= n; gx++) {
+                float fx = static_cast<float>(gx) / n;
+                glm::vec2 pos(cell.x + fx * cell.w, cell.y + fy * cell.h);
+                glm::vec2 texCoord = cell.topLeft + texSize * glm::vec2(fx, fy);
+
+                if (cell.table >= 0) {
+                    texCoord = sampleRemapTable(m_remapTables[cell.table],
+                                                remapWidth, remapHeight,
+                                                texCoord.x, texCoord.y);
+                }
+                m_vertices.push_back({pos, texCoord});
+            }
+        }
+    }
+
+    if (baked) {
+        m_remapTables.clear();
+        m_remapTables.shrink_to_fit();
+    }
+}
+
+/*
+ * moves the meshes to the window's new aspect, their texture coordinates
+ * stay, so tables baked into them are not needed again. The gpu must be
+ * idle
+ */
+void Render::updateVertexLayout()
+{
+    std::vector<MeshCell> cells = layoutMeshes();
+    int n = meshDensity;
+    size_t i = 0;
+    for (const MeshCell& cell : cells) {
+        for (int gy = 0; gy <= n; gy++) {
+            float fy = static_cast<float>(gy) / n;
+            for (int gx = 0; gx <= n; gx++) {
+                float fx = static_cast<float>(gx) / n;
+                m_vertices.at(i++).pos =
+                    glm::vec2(cell.x + fx * cell.w, cell.y + fy * cell.h);
+            }
+        }
+    }
+
+    uint32_t bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
+    void *data = m_device->mapMemory(*m_uVertexBufferMem, 0, bufferSize);
+    memcpy(data, m_vertices.data(), bufferSize);
+    m_device->unmapMemory(*m_uVertexBufferMem);
 }
 
 void Render::createVertexBuffer()
 {
-    uint32_t bufferSize = sizeof(vertices[0]) * vertices.size();
+    createVertices();
+    uint32_t bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
 
     m_uVertexBuffer = m_device->createBufferUnique(
             vk::BufferCreateInfo({}, bufferSize,
@@ -948,7 +2716,7 @@ void Render::createVertexBuffer()
 
     void *data = m_device->mapMemory(*m_uVertexBufferMem, 0,
             memRequirements.size);
-    memcpy(data, vertices.data(), bufferSize);
+    memcpy(data, m_vertices.data(), bufferSize);
     m_device->unmapMemory(*m_uVertexBufferMem);
 
     m_device->bindBufferMemory(*m_uVertexBuffer, *m_uVertexBufferMem, 0);
@@ -956,6 +2724,19 @@ void Render::createVertexBuffer()
 
 void Render::createIndexBuffer()
 {
+    // two triangles per cell, the vertices of a mesh come row after row
+    std::vector<uint16_t> indices;
+    int row = meshDensity + 1;
+    for (int gy = 0; gy < meshDensity; gy++) {
+        for (int gx = 0; gx < meshDensity; gx++) {
+            int i = gy * row + gx;
+            for (int k : {i, i + 1, i + row, i + 1, i + row + 1, i + row}) {
+                indices.push_back(static_cast<uint16_t>(k));
+            }
+        }
+    }
+    m_indexCount = indices.size();
+
     uint32_t bufferSize = sizeof(indices[0]) * indices.size();
 
     m_uIndexBuffer = m_device->createBufferUnique(
@@ -1000,10 +2781,11 @@ void Render::createUniformBuffers()
 {
     uint32_t bufferSize = sizeof(UniformBufferObject);
 
-    m_uniformBuffers.resize(m_swapChainImages.size());
-    m_uniformBuffersMemory.resize(m_swapChainImages.size());
+    m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-    for (size_t i = 0; i < m_swapChainImages.size(); i++) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         m_uniformBuffers.at(i) = m_device->createBufferUnique(
                 vk::BufferCreateInfo({}, bufferSize,
                                      vk::BufferUsageFlagBits::eUniformBuffer));
@@ -1019,10 +2801,14 @@ void Render::createUniformBuffers()
 
         m_device->bindBufferMemory(*m_uniformBuffers.at(i),
                                    *m_uniformBuffersMemory.at(i), 0);
+
+        // stays mapped, the memory is freed together with the buffer
+        m_uniformBuffersMapped.at(i) =
+            m_device->mapMemory(*m_uniformBuffersMemory.at(i), 0, bufferSize);
     }
 }
 
-void Render::updateUniformBuffer(uint32_t currentImage)
+void Render::updateUniformBuffer(uint32_t currentFrame)
 {
     static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -1047,100 +2833,206 @@ void Render::updateUniformBuffer(uint32_t currentImage)
     ubo.view = glm::mat4(1.0f);
     ubo.proj = glm::mat4(1.0f);
 
-    void *data = m_device->mapMemory(*m_uniformBuffersMemory.at(currentImage),
-                                     0, sizeof(ubo));
-    memcpy(data, &ubo, sizeof(ubo));
-    m_device->unmapMemory(*m_uniformBuffersMemory.at(currentImage));
+    memcpy(m_uniformBuffersMapped.at(currentFrame), &ubo, sizeof(ubo));
 }
 
 void Render::createDescriptorPool()
 {
-    uint32_t descriptCnt = static_cast<uint32_t>(m_swapChainImages.size());
-    descriptCnt *= 4;
+    uint32_t descriptCnt = MAX_FRAMES_IN_FLIGHT;
 
-    std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+    // plus the demosaic set and a compose set per frame in flight
+    std::array<vk::DescriptorPoolSize, 3> poolSizes = {
         vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,
                                descriptCnt),
         vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,
-                               descriptCnt)};
+                               descriptCnt * 4 + 1 + descriptCnt * 3),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage,
+                               1 + descriptCnt)};
 
     m_descriptorPool = m_device->createDescriptorPoolUnique(
             vk::DescriptorPoolCreateInfo(
                 vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-                descriptCnt, poolSizes.size(), poolSizes.data()));
+                descriptCnt * 2 + 1, poolSizes.size(), poolSizes.data()));
 }
 
 void Render::createDescriptorSets()
 {
-    std::vector<vk::DescriptorSetLayout> layouts(m_swapChainImages.size(),
+    std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT,
                                                  *m_descriptorSetLayout);
 
     m_descriptorSets = m_device->allocateDescriptorSetsUnique(
             vk::DescriptorSetAllocateInfo(
                 *m_descriptorPool,
-                static_cast<uint32_t>(m_swapChainImages.size()),
+                static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
                 layouts.data()));
 
-    for (size_t i = 0; i < m_swapChainImages.size(); i++) {
+    // the same for every frame in flight
+    vk::DescriptorImageInfo
+        imageInfo(*m_utextureSampler, *m_utextureImageView,
+                vk::ImageLayout::eShaderReadOnlyOptimal);
+    if (m_udemosaicImageView) {
+        imageInfo.imageView = *m_udemosaicImageView;
+        imageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    }
+
+    // every binding has to be valid, formats without a CbCr plane
+    // point it at the main texture, the shader never reads it then
+    vk::DescriptorImageInfo chromaInfo = imageInfo;
+    if (m_uchromaImageView)
+        chromaInfo.imageView = *m_uchromaImageView;
+    vk::DescriptorImageInfo remapInfo = imageInfo;
+    if (m_uremapImageView) {
+        remapInfo = vk::DescriptorImageInfo(
+                *m_uremapSampler, *m_uremapImageView,
+                vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+    vk::DescriptorImageInfo surroundInfo = imageInfo;
+    if (m_usurroundImageView) {
+        surroundInfo = vk::DescriptorImageInfo(
+                *m_usurroundSampler, *m_usurroundImageView,
+                vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vk::DescriptorBufferInfo bufferInfo(*m_uniformBuffers.at(i),
                 0, sizeof(UniformBufferObject));
 
-        vk::DescriptorImageInfo
-            imageInfo(*m_utextureSampler, *m_utextureImageView,
-                    vk::ImageLayout::eShaderReadOnlyOptimal);
-
-        std::array<vk::WriteDescriptorSet, 2> descriptorWrites = {
+        std::array<vk::WriteDescriptorSet, 5> descriptorWrites = {
             vk::WriteDescriptorSet(*m_descriptorSets.at(i), 0, 0, 1,
                     vk::DescriptorType::eUniformBuffer,
                     nullptr, &bufferInfo),
             vk::WriteDescriptorSet(*m_descriptorSets.at(i), 1, 0, 1,
                     vk::DescriptorType::eCombinedImageSampler,
-                    &imageInfo, nullptr) };
+                    &imageInfo, nullptr),
+            vk::WriteDescriptorSet(*m_descriptorSets.at(i), 2, 0, 1,
+                    vk::DescriptorType::eCombinedImageSampler,
+                    &chromaInfo, nullptr),
+            vk::WriteDescriptorSet(*m_descriptorSets.at(i), 3, 0, 1,
+                    vk::DescriptorType::eCombinedImageSampler,
+                    &remapInfo, nullptr),
+            vk::WriteDescriptorSet(*m_descriptorSets.at(i), 4, 0, 1,
+                    vk::DescriptorType::eCombinedImageSampler,
+                    &surroundInfo, nullptr) };
         m_device->updateDescriptorSets(descriptorWrites, {});
     }
+
+    // their output images are written along with the images
+    if (m_composePipeline) {
+        std::vector<vk::DescriptorSetLayout> composeLayouts(
+                MAX_FRAMES_IN_FLIGHT, *m_composeSetLayout);
+        m_composeSets = m_device->allocateDescriptorSetsUnique(
+                vk::DescriptorSetAllocateInfo(
+                    *m_descriptorPool,
+                    static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+                    composeLayouts.data()));
+
+        for (auto& composeSet : m_composeSets) {
+            std::array<vk::WriteDescriptorSet, 3> composeWrites = {
+                vk::WriteDescriptorSet(*composeSet, 1, 0, 1,
+                        vk::DescriptorType::eCombinedImageSampler,
+                        &imageInfo, nullptr),
+                vk::WriteDescriptorSet(*composeSet, 2, 0, 1,
+                        vk::DescriptorType::eCombinedImageSampler,
+                        &chromaInfo, nullptr),
+                vk::WriteDescriptorSet(*composeSet, 4, 0, 1,
+                        vk::DescriptorType::eCombinedImageSampler,
+                        &surroundInfo, nullptr) };
+            m_device->updateDescriptorSets(composeWrites, {});
+        }
+    }
+
+    if (!isBayer())
+        return;
+
+    std::vector<vk::UniqueDescriptorSet> demosaicSets =
+        m_device->allocateDescriptorSetsUnique(
+                vk::DescriptorSetAllocateInfo(*m_descriptorPool, 1,
+                                              &*m_demosaicSetLayout));
+    m_demosaicSet = std::move(demosaicSets.at(0));
+
+    vk::DescriptorImageInfo rawInfo(*m_urawSampler, *m_utextureImageView,
+                                    vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::DescriptorImageInfo outInfo(nullptr, *m_udemosaicImageView,
+                                    vk::ImageLayout::eGeneral);
+    std::array<vk::WriteDescriptorSet, 2> demosaicWrites = {
+        vk::WriteDescriptorSet(*m_demosaicSet, 0, 0, 1,
+                vk::DescriptorType::eCombinedImageSampler,
+                &rawInfo, nullptr),
+        vk::WriteDescriptorSet(*m_demosaicSet, 1, 0, 1,
+                vk::DescriptorType::eStorageImage,
+                &outInfo, nullptr) };
+    m_device->updateDescriptorSets(demosaicWrites, {});
 }
 
-void Render::createCommandBuffers(int index)
+void Render::createCommandBuffers()
 {
     m_commandBuffers = m_device->allocateCommandBuffersUnique(
             vk::CommandBufferAllocateInfo(*m_commandPool,
                                           vk::CommandBufferLevel::ePrimary,
-                                          (uint32_t)m_swapChainFramebuffers.size()));
+                                          MAX_FRAMES_IN_FLIGHT));
 
-    for (size_t i = 0; i < m_commandBuffers.size(); i++) {
-        m_commandBuffers.at(i)->begin(
-            vk::CommandBufferBeginInfo(
-                vk::CommandBufferUsageFlagBits::eSimultaneousUse));
-
-        vk::ClearValue clearColor(
-                vk::ClearColorValue(
-                    std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f})));
-        m_commandBuffers.at(i)->beginRenderPass(
-            vk::RenderPassBeginInfo(*m_renderPass,
-                                    *m_swapChainFramebuffers.at(i),
-                                    vk::Rect2D(vk::Offset2D(0, 0),
-                                               m_swapChainExtent),
-                                    1, &clearColor),
-            vk::SubpassContents::eInline);
-        m_commandBuffers.at(i)->bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                             *m_graphicsPipeline);
-
-        vk::DeviceSize offset = 0;
-        m_commandBuffers.at(i)->bindVertexBuffers(0, *m_uVertexBuffer, offset);
-        m_commandBuffers.at(i)->bindIndexBuffer(*m_uIndexBuffer, 0,
-                                                vk::IndexType::eUint16);
-        m_commandBuffers.at(i)->bindDescriptorSets(
-                vk::PipelineBindPoint::eGraphics, *m_pipelineLayout, 0, 1,
-                &*m_descriptorSets.at(i), 0, nullptr);
-
-        for (int j = 0; j < 4; j++) {
-            m_commandBuffers.at(i)->drawIndexed(4, 1, 0,
-                    j * 4, j);
-        }
+    m_frameUploads.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto& uploads : m_frameUploads) {
+        uploads.reserve(camNum);
+    }
+    m_pendingUploads.reserve(camNum);
+    // a luma and a chroma layer per camera at most
+    m_uploadBarriers.reserve(camNum * 2);
+
+    if (!supportsAsyncCompose())
+        return;
+
+    m_composeCommandBuffers = m_device->allocateCommandBuffersUnique(
+            vk::CommandBufferAllocateInfo(*m_computeCommandPool,
+                                          vk::CommandBufferLevel::ePrimary,
+                                          MAX_FRAMES_IN_FLIGHT));
+    m_blitCommandBuffers = m_device->allocateCommandBuffersUnique(
+            vk::CommandBufferAllocateInfo(*m_commandPool,
+                                          vk::CommandBufferLevel::ePrimary,
+                                          MAX_FRAMES_IN_FLIGHT));
+}
+
+void Render::recordCommandBuffer(vk::CommandBuffer cmd, uint32_t imageIndex)
+{
+    if (m_view == View::Surround)
+        beginComposeTime(cmd, Compose::Raster);
 
-        m_commandBuffers.at(i)->endRenderPass();
-        m_commandBuffers.at(i)->end();
+    vk::ClearValue clearColor(
+            vk::ClearColorValue(
+                std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f})));
+    cmd.beginRenderPass(
+        vk::RenderPassBeginInfo(*m_renderPass,
+                                *m_swapChainFramebuffers.at(imageIndex),
+                                vk::Rect2D(vk::Offset2D(0, 0),
+                                           m_swapChainExtent),
+                                1, &clearColor),
+        vk::SubpassContents::eInline);
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                     m_view == View::Surround ? *m_surroundPipeline :
+                                                *m_graphicsPipeline);
+
+    vk::DeviceSize offset = 0;
+    cmd.bindVertexBuffers(0, *m_uVertexBuffer, offset);
+    cmd.bindIndexBuffer(*m_uIndexBuffer, 0, vk::IndexType::eUint16);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                           *m_pipelineLayout, 0, 1,
+                           &*m_descriptorSets.at(m_currentFrame), 0, nullptr);
+
+    // the surround view is a single draw that looks up all cameras
+    int32_t meshSize = (meshDensity + 1) * (meshDensity + 1);
+    if (m_view == View::Surround) {
+        cmd.drawIndexed(m_indexCount, 1, 0, camNum * 2 * meshSize, 0);
+    } else {
+        int32_t firstMesh = m_view == View::Strip ? camNum : 0;
+        for (int j = 0; j < camNum; j++) {
+            cmd.drawIndexed(m_indexCount, 1, 0, (firstMesh + j) * meshSize, j);
+        }
     }
+
+    cmd.endRenderPass();
+
+    if (m_view == View::Surround)
+        endComposeTime(cmd);
 }
 
 void Render::createSyncObjects()
@@ -1156,6 +3048,31 @@ void Render::createSyncObjects()
             m_device->createFenceUnique(
                 vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled)));
     }
+
+    if (!supportsAsyncCompose())
+        return;
+
+#ifdef VK_KHR_timeline_semaphore
+    if (m_timelineSemaphores) {
+        vk::SemaphoreTypeCreateInfoKHR timelineInfo(
+                vk::SemaphoreTypeKHR::eTimeline, m_composeTimelineValue);
+        vk::SemaphoreCreateInfo createInfo;
+        createInfo.pNext = &timelineInfo;
+        m_composeTimeline = m_device->createSemaphoreUnique(createInfo);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        m_uploadedSemaphores.push_back(
+            m_device->createSemaphoreUnique(vk::SemaphoreCreateInfo()));
+
+        m_composedSemaphores.push_back(
+            m_device->createSemaphoreUnique(vk::SemaphoreCreateInfo()));
+
+        m_composeReadSemaphores.push_back(
+            m_device->createSemaphoreUnique(vk::SemaphoreCreateInfo()));
+    }
 }
 
 void Render::framebufferResizeCallback(GLFWwindow *window,
@@ -1167,33 +3084,16 @@ void Render::framebufferResizeCallback(GLFWwindow *window,
 
 void Render::cleanupSwapChain()
 {
-    for (auto &framebuffer : m_swapChainFramebuffers) {
-        m_device->destroyFramebuffer(*framebuffer);
-    }
-
-    for (auto &commandBuffer : m_commandBuffers) {
-        commandBuffer.reset();
-    }
-
-    m_device->destroyPipeline(*m_graphicsPipeline);
-    m_device->destroyPipelineLayout(*m_pipelineLayout);
-    m_device->destroyRenderPass(*m_renderPass);
-
-    for (auto &imageView : m_swapChainImageViews) {
-        m_device->destroyImageView(*imageView);
-    }
-
-    m_device->destroySwapchainKHR(*m_swapChain);
-
-    for (size_t i = 0; i < m_swapChainImages.size(); i++) {
-        m_uniformBuffers.at(i).reset();
-        m_uniformBuffersMemory.at(i).reset();
-    }
-
-    m_descriptorPool.reset();
+    m_swapChainFramebuffers.clear();
+    m_graphicsPipeline.reset();
+    m_surroundPipeline.reset();
+    m_pipelineLayout.reset();
+    m_renderPass.reset();
+    m_swapChainImageViews.clear();
+    m_swapChain.reset();
 }
 
-void Render::recreateSwapChain(int index)
+void Render::recreateSwapChain()
 {
     int width = 0, height = 0;
     while (width == 0 || height == 0) {
@@ -1210,9 +3110,7 @@ void Render::recreateSwapChain(int index)
     createRenderPass();
     createGraphicsPipeline();
     createFramebuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers(index);
+    createComposeImage();
+    updateVertexLayout();
 }
 
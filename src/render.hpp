@@ -11,6 +11,8 @@
 #include <array>
 #include <cstddef>
 #include <memory>
+#include <cstdlib>
+#include <atomic>
 
 #include "message.hpp"
 
@@ -54,9 +56,267 @@ public:
         alignas(16) glm::mat4 proj;
     };
 
+    // layout of the camera frames, converted to rgb in the fragment shader
+    enum class InputFormat
+    {
+        XBGR32,
+        // 4:2:2 packed, Y0 Cb Y1 Cr
+        YUYV,
+        // 4:2:0, Y plane followed by an interleaved CbCr plane
+        NV12,
+        // raw bayer in 16 bit words, demosaiced by a compute pass
+        Bayer10,
+        Bayer12,
+    };
+
+    // where the red sample sits in the first 2x2 cell
+    enum class CfaPattern
+    {
+        RGGB,
+        GRBG,
+        GBRG,
+        BGGR,
+    };
+
+    struct BayerParams
+    {
+        CfaPattern pattern = CfaPattern::RGGB;
+        // in sensor units, a white level of 0 means the largest value of
+        // the bit depth
+        float blackLevel = 0.0f;
+        float whiteLevel = 0.0f;
+        // white balance
+        float gainR = 1.0f;
+        float gainG = 1.0f;
+        float gainB = 1.0f;
+    };
+
+    // takes effect with the next frame, call it from the render thread
+    void setBayerParams(const BayerParams& params)
+    {
+        m_bayerParams = params;
+    }
+
+    // how the cameras are laid out in the window
+    enum class View
+    {
+        // a cell of a two column grid per camera
+        Grid,
+        // side by side in a single row
+        Strip,
+        // the ground around the cameras from above, see setSurroundTable
+        Surround,
+    };
+
+    // how the surround view is put together
+    enum class Compose
+    {
+        // drawn into the swapchain image by shader.frag
+        Raster,
+        // a compose.comp dispatch into a storage image, blitted over
+        Compute,
+        // the same dispatch on a compute only queue family, so the next
+        // frame is composed while the graphics queue presents this one
+        AsyncCompute,
+    };
+
+    // where v4l2 USERPTR frames land before the upload
+    enum class StagingMode
+    {
+        // one host visible allocation mapped into our address space
+        HostCoherent,
+        // aligned host allocation imported with VK_EXT_external_memory_host,
+        // falls back to HostCoherent when the device can not import
+        HostImport,
+    };
+
+    void setStagingMode(StagingMode mode)
+    {
+        m_stagingMode = mode;
+    }
+    StagingMode getStagingMode() const
+    {
+        return m_stagingMode;
+    }
+
+    /*
+     * where the frames lie on the sensor when the cameras capture a crop of
+     * it, the frames being the crop's size. Without it they show the whole
+     * sensor. Call it before init()
+     */
+    void setSensorCrop(int sensorWidth_, int sensorHeight_, int left, int top)
+    {
+        sensorWidth = sensorWidth_;
+        sensorHeight = sensorHeight_;
+        cropLeft = left;
+        cropTop = top;
+    }
+
+    /*
+     * lens correction: per camera, width * height pairs of the texture
+     * coordinates each pixel of the corrected view samples, outside 0..1
+     * where there is nothing to show. The tables are uploaded once and
+     * replace the plain mapping of the frames, crop included. Call it
+     * before init()
+     */
+    void setRemapTables(int width, int height,
+                        std::vector<std::vector<float>> tables)
+    {
+        remapWidth = width;
+        remapHeight = height;
+        m_remapTables = std::move(tables);
+    }
+
+    /*
+     * every camera is drawn as a mesh of density * density cells. With
+     * remap tables the correction moves into the vertices of the mesh
+     * instead of a lookup per pixel, a finer mesh following the lens more
+     * closely. At most 255, call it before init()
+     */
+    void setWarpMesh(int density)
+    {
+        meshDensity = density;
+        meshWarp = true;
+    }
+
+    /*
+     * surround view: per pixel of the width * height top view, samples holds
+     * the texture coordinates of two cameras (u0 v0 u1 v1) and blend which
+     * layers those are and their weights (cam0 cam1 w0 w1), cam0 being
+     * negative where nothing is seen. Everything but the frames
+     * is looked up from these, which are uploaded once. Call it before
+     * init()
+     */
+    void setSurroundTable(int width, int height, std::vector<float> samples,
+                          std::vector<float> blend)
+    {
+        surroundWidth = width;
+        surroundHeight = height;
+        m_surroundTables.clear();
+        m_surroundTables.push_back(std::move(samples));
+        m_surroundTables.push_back(std::move(blend));
+    }
+    bool hasSurround() const
+    {
+        return surroundWidth > 0;
+    }
+
+    // from the render thread, shown from the next frame on. Surround needs
+    // its table
+    void setView(View view)
+    {
+        if (view != View::Surround || hasSurround())
+            m_view = view;
+    }
+
+    // after init(), Compute needs the surround view and a device that can
+    // blit a storage image into the swapchain
+    bool supportsComputeCompose() const
+    {
+        return static_cast<bool>(m_composePipeline);
+    }
+    // AsyncCompute also needs a queue family with compute but no graphics
+    bool supportsAsyncCompose() const
+    {
+        return supportsComputeCompose() &&
+               m_computeFamily != VK_QUEUE_FAMILY_IGNORED;
+    }
+    // from the render thread, the grid and strip views are always drawn
+    void setCompose(Compose compose)
+    {
+        if ((compose != Compose::Compute || supportsComputeCompose()) &&
+            (compose != Compose::AsyncCompute || supportsAsyncCompose()))
+            m_compose = compose;
+    }
+
+    // workgroup of compose.comp in pixels, a tile of the output
+    struct ComposeGroup
+    {
+        uint32_t width = 8;
+        uint32_t height = 8;
+    };
+
+    // within the device's compute limits, after init()
+    bool supportsComposeGroup(const ComposeGroup& group) const;
+    /*
+     * before init() the workgroup is checked against the device there, the
+     * default is kept when it does not fit. Later, from the render thread,
+     * the compute pipeline is recreated once the frames in flight are done
+     * with the old one, and an unsupported workgroup is ignored
+     */
+    void setComposeGroup(const ComposeGroup& group);
+    const ComposeGroup& getComposeGroup() const
+    {
+        return m_composeGroup;
+    }
+
+    struct BenchResult
+    {
+        Compose compose;
+        // of the compute paths
+        ComposeGroup group;
+        int frames;
+        // gpu time, as by getAvgComposeUs and getMaxComposeUs
+        int64_t avgUs;
+        int64_t maxUs;
+        // wall time per frame, presentation included
+        int64_t frameUs;
+    };
+
+    /*
+     * renders the surround view by every supported path, frames times each
+     * from the textures as they are, no frames are taken meanwhile. Compute
+     * runs once per workgroup of a few candidate tilings. The view, the path
+     * and the workgroup are restored afterwards. Call it from the render
+     * thread, empty without the surround view
+     */
+    std::vector<BenchResult> benchCompose(int frames);
+
+    // gpu time of the surround view by each path, from timestamps around
+    // it, 0 while not measured or where the queue has no timestamps.
+    // AsyncCompute only times the dispatch, its blit is on the graphics queue
+    int64_t getLastComposeUs(Compose compose) const
+    {
+        return composeTime(compose).last.load(std::memory_order_relaxed);
+    }
+    int64_t getAvgComposeUs(Compose compose) const
+    {
+        const GpuTime& t = composeTime(compose);
+        uint64_t count = t.count.load(std::memory_order_relaxed);
+        return count ? t.total.load(std::memory_order_relaxed) /
+                       static_cast<int64_t>(count) : 0;
+    }
+    int64_t getMaxComposeUs(Compose compose) const
+    {
+        return composeTime(compose).max.load(std::memory_order_relaxed);
+    }
+
     void init();
     void updateTexture(const std::shared_ptr<PixelBufferBase>& pbuf);
     std::vector<std::vector<PixelBufferBase>> getBufferBank();
+    bool supportsDmaBufImport() const
+    {
+        return m_dmaBufImport;
+    }
+    // upload the camera's frames straight from its exported v4l2 buffers,
+    // buffers[i] and fds[i] describe the same buffer. This saves the cpu
+    // copy into the staging memory, the gpu still copies each frame into
+    // the texture array. Importing a camera again, after it was reopened,
+    // replaces its earlier buffers
+    void importDmaBuf(int camIndex, const std::vector<PixelBufferBase>& buffers,
+                      const std::vector<int>& fds);
+    bool supportsHostImport() const
+    {
+        return m_hostImport;
+    }
+    // upload straight from host memory the caller keeps mapped, such as a
+    // replayed session. frames[cam][i] lies within it and is uploaded for
+    // the camera's frames of subIndex i
+    void importHostMemory(void* base, size_t size,
+                          const std::vector<std::vector<PixelBufferBase>>& frames);
+    // a lost camera's layer shows a placeholder, its frames are ignored
+    // until it is back. Call it from the render thread
+    void setCameraLost(int camIndex, bool lost);
     void render(int index);
     bool checkValidationLayerSupport();
     bool shouldStop()
@@ -73,7 +333,8 @@ public:
     }
 
     Render();
-    Render(int width, int height, int pixelSize_, int camNum_, int camBufNum_);
+    Render(int width, int height, InputFormat inputFormat_, int camNum_,
+           int camBufNum_);
     Render(const Render&) = delete;
     Render& operator=(const Render&) = delete;
     virtual ~Render();
@@ -89,10 +350,16 @@ private:
     vk::UniqueDevice m_device;
     vk::Queue m_graphicsQueue;
     vk::Queue m_presentQueue;
+    // a compute only family for AsyncCompute, ignored when there is none
+    uint32_t m_graphicsFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t m_computeFamily = VK_QUEUE_FAMILY_IGNORED;
+    vk::Queue m_computeQueue;
+    bool m_timelineSemaphores = false;
     vk::UniqueSwapchainKHR m_swapChain;
     std::vector<vk::Image> m_swapChainImages;
     vk::Format m_swapChainImageFormat;
     vk::Extent2D m_swapChainExtent;
+    bool m_swapChainTransferDst = false;
     std::vector<vk::UniqueImageView> m_swapChainImageViews;
     std::vector<vk::UniqueFramebuffer> m_swapChainFramebuffers;
 
@@ -100,42 +367,200 @@ private:
     vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
     vk::UniquePipelineLayout m_pipelineLayout;
     vk::UniquePipeline m_graphicsPipeline;
+    // shader.frag specialized for the surround view, null without it
+    vk::UniquePipeline m_surroundPipeline;
 
     vk::UniqueCommandPool m_commandPool;
+    vk::UniqueCommandPool m_computeCommandPool;
 
     //texture
     vk::UniqueImage m_utextureImage;
     vk::UniqueDeviceMemory m_utextureMem;
     vk::UniqueImageView m_utextureImageView;
     vk::UniqueSampler m_utextureSampler;
+    // CbCr plane of NV12 frames, half the size of the luma texture
+    vk::UniqueImage m_uchromaImage;
+    vk::UniqueDeviceMemory m_uchromaMem;
+    vk::UniqueImageView m_uchromaImageView;
+    // bayer input: the raw layers above are demosaiced into this one, which
+    // the fragment shader samples instead
+    BayerParams m_bayerParams;
+    vk::UniqueImage m_udemosaicImage;
+    vk::UniqueDeviceMemory m_udemosaicMem;
+    vk::UniqueImageView m_udemosaicImageView;
+    vk::UniqueSampler m_urawSampler;
+    // RG32F texture coordinates per camera layer, sampled before the frame
+    int remapWidth = 0;
+    int remapHeight = 0;
+    std::vector<std::vector<float>> m_remapTables;
+    vk::UniqueImage m_uremapImage;
+    vk::UniqueDeviceMemory m_uremapMem;
+    vk::UniqueImageView m_uremapImageView;
+    vk::UniqueSampler m_uremapSampler;
+    // RGBA32F samples and blend layers of the surround view
+    int surroundWidth = 0;
+    int surroundHeight = 0;
+    std::vector<std::vector<float>> m_surroundTables;
+    vk::UniqueImage m_usurroundImage;
+    vk::UniqueDeviceMemory m_usurroundMem;
+    vk::UniqueImageView m_usurroundImageView;
+    vk::UniqueSampler m_usurroundSampler;
+    // cells per side of every camera's mesh, which takes the remap tables
+    // into its vertices with meshWarp
+    int meshDensity = 1;
+    bool meshWarp = false;
+    View m_view = View::Grid;
+    vk::UniqueDescriptorSetLayout m_demosaicSetLayout;
+    vk::UniquePipelineLayout m_demosaicPipelineLayout;
+    vk::UniquePipeline m_demosaicPipeline;
+    vk::UniqueDescriptorSet m_demosaicSet;
+    // compute path of the surround view, its output is the swapchain's size.
+    // An image per frame in flight, so composing one frame does not wait
+    // for the blit of the other
+    Compose m_compose = Compose::Raster;
+    ComposeGroup m_composeGroup;
+    vk::UniqueDescriptorSetLayout m_composeSetLayout;
+    vk::UniquePipelineLayout m_composePipelineLayout;
+    // kept to specialize the pipeline for another workgroup
+    vk::UniqueShaderModule m_composeShader;
+    vk::UniquePipeline m_composePipeline;
+    std::vector<vk::UniqueDescriptorSet> m_composeSets;
+    std::vector<vk::UniqueImage> m_ucomposeImages;
+    std::vector<vk::UniqueDeviceMemory> m_ucomposeMems;
+    std::vector<vk::UniqueImageView> m_ucomposeImageViews;
+    // must outlive the staging buffer it is imported into
+    std::unique_ptr<void, decltype(&free)> m_hostStageMem{nullptr, &free};
     vk::UniqueBuffer m_uStageBuffer;
     vk::UniqueDeviceMemory m_uStageMem;
+    StagingMode m_stagingMode = StagingMode::HostCoherent;
     int textureWidth = 0;
     int textureHeight = 0;
-    int pixelSize = 0;
+    // 0 when the frames are the whole sensor
+    int sensorWidth = 0;
+    int sensorHeight = 0;
+    int cropLeft = 0;
+    int cropTop = 0;
+    InputFormat inputFormat = InputFormat::XBGR32;
     int camNum = 0;
     int camBufNum = 0;
     std::vector<std::vector<PixelBufferBase>> m_stageMemMaps;
 
+    // where each [camera][buffer] frame is uploaded from, either the shared
+    // staging buffer or an imported dma-buf
+    struct StageRegion
+    {
+        vk::Buffer buffer;
+        vk::DeviceSize offset;
+    };
+    std::vector<std::vector<StageRegion>> m_stageRegions;
+    std::vector<vk::UniqueBuffer> m_importedBuffers;
+    std::vector<vk::UniqueDeviceMemory> m_importedMems;
+    // per camera, replaced when a camera imports again
+    std::vector<std::vector<vk::UniqueBuffer>> m_dmaBufBuffers;
+    std::vector<std::vector<vk::UniqueDeviceMemory>> m_dmaBufMems;
+    // replaced imports, kept until the frames in flight that may still
+    // copy from them have finished
+    struct RetiredDmaBuf
+    {
+        std::vector<vk::UniqueBuffer> buffers;
+        std::vector<vk::UniqueDeviceMemory> mems;
+        int fencesLeft;
+    };
+    std::vector<RetiredDmaBuf> m_retiredDmaBufs;
+    bool m_externalMemoryCapable = false;
+    bool m_dmaBufImport = false;
+    bool m_hostImport = false;
+    vk::DeviceSize m_importedHostPointerAlignment = 0;
+
+    // texture uploads, batched per Commit and recorded into the frame's
+    // command buffer, frames stay referenced until that frame's fence
+    std::vector<std::shared_ptr<PixelBufferBase>> m_pendingUploads;
+    std::vector<std::vector<std::shared_ptr<PixelBufferBase>>> m_frameUploads;
+    std::vector<vk::ImageMemoryBarrier> m_uploadBarriers;
+    // cameras currently lost, and those whose layer still has to be cleared
+    uint32_t m_lostMask = 0;
+    uint32_t m_placeholderMask = 0;
+
+    // the meshes of every view, camera after camera, sharing their indices
+    std::vector<Vertex> m_vertices;
     vk::UniqueBuffer m_uVertexBuffer;
     vk::UniqueDeviceMemory m_uVertexBufferMem;
     vk::UniqueBuffer m_uIndexBuffer;
     vk::UniqueDeviceMemory m_uIndexBufferMemory;
+    uint32_t m_indexCount = 0;
 
     std::vector<vk::UniqueBuffer> m_uniformBuffers;
     std::vector<vk::UniqueDeviceMemory> m_uniformBuffersMemory;
+    std::vector<void*> m_uniformBuffersMapped;
 
     vk::UniqueDescriptorPool m_descriptorPool;
     std::vector<vk::UniqueDescriptorSet> m_descriptorSets;
 
     std::vector<vk::UniqueCommandBuffer> m_commandBuffers;
+    // AsyncCompute: the dispatch on the compute queue, then the blit back on
+    // the graphics queue
+    std::vector<vk::UniqueCommandBuffer> m_composeCommandBuffers;
+    std::vector<vk::UniqueCommandBuffer> m_blitCommandBuffers;
 
     std::vector<vk::UniqueSemaphore> m_imageAvailableSemaphores;
     std::vector<vk::UniqueSemaphore> m_renderFinishedSemaphores;
     std::vector<vk::UniqueFence> m_inFlightFences;
+    // orders the uploads, the dispatch and the blit of AsyncCompute, a
+    // single timeline counting up two values per frame, or binary
+    // semaphores per frame in flight without VK_KHR_timeline_semaphore
+    vk::UniqueSemaphore m_composeTimeline;
+    uint64_t m_composeTimelineValue = 0;
+    std::vector<vk::UniqueSemaphore> m_uploadedSemaphores;
+    std::vector<vk::UniqueSemaphore> m_composedSemaphores;
+    // the dispatch of the last AsyncCompute frame may still be reading the
+    // textures the next frame uploads into, whose first submit waits for
+    // it. The timeline at the composed value, or a binary semaphore per
+    // frame in flight signaled with the composed one, null once waited for
+    std::vector<vk::UniqueSemaphore> m_composeReadSemaphores;
+    vk::Semaphore m_composeReads;
+    uint64_t m_composeReadsValue = 0;
     size_t m_currentFrame = 0;
     bool framebufferResized = false;
 
+    // written by the render thread only
+    struct GpuTime
+    {
+        std::atomic<int64_t> last{0};
+        std::atomic<int64_t> total{0};
+        std::atomic<int64_t> max{0};
+        std::atomic<uint64_t> count{0};
+
+        void reset()
+        {
+            last.store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            max.store(0, std::memory_order_relaxed);
+            count.store(0, std::memory_order_relaxed);
+        }
+
+        void add(int64_t us)
+        {
+            last.store(us, std::memory_order_relaxed);
+            total.fetch_add(us, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            if (us > max.load(std::memory_order_relaxed))
+                max.store(us, std::memory_order_relaxed);
+        }
+    };
+    // two timestamps per frame in flight, and which path each frame timed
+    vk::UniqueQueryPool m_timestampPool;
+    float m_timestampPeriod = 0;
+    uint64_t m_timestampMask = 0;
+    // 0 when the compute family has no timestamps
+    uint64_t m_computeTimestampMask = 0;
+    std::vector<int> m_timedCompose;
+    GpuTime m_composeTimes[3];
+
+    const GpuTime& composeTime(Compose compose) const
+    {
+        return m_composeTimes[static_cast<int>(compose)];
+    }
+
     void initWindow();
 
     std::vector<const char*> getRequiredExtension();
@@ -151,6 +576,8 @@ private:
     struct QueueFamilyIndices {
         uint32_t graphicsFamily = -1;
         uint32_t presentFamily = -1;
+        // optional, compute without graphics
+        uint32_t computeFamily = VK_QUEUE_FAMILY_IGNORED;
 
         bool isComplete()
         {
@@ -161,11 +588,16 @@ private:
     void pickPhysicalDevice();
     bool isDeviceSuitable(vk::PhysicalDevice device);
     bool checkDeviceExtensionSupport(vk::PhysicalDevice device);
+    bool checkDeviceExtensionSupport(vk::PhysicalDevice device,
+                                     const std::vector<const char*>& extensions);
     QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice device);
 
     void createLogicalDevice();
 
     static const std::vector<const char *> deviceExtensions;
+    static const std::vector<const char *> externalMemoryInstanceExtensions;
+    static const std::vector<const char *> dmaBufDeviceExtensions;
+    static const std::vector<const char *> hostImportDeviceExtensions;
     struct SwapChainSupportDetails {
         vk::SurfaceCapabilitiesKHR capabilities;
         std::vector<vk::SurfaceFormatKHR> formats;
@@ -197,25 +629,87 @@ private:
                                vk::ImageLayout newLayout,
                                vk::PipelineStageFlags srcStageMask,
                                vk::PipelineStageFlags dstStageMask);
+    vk::DeviceSize getFrameSize() const;
+    vk::Format getTextureFormat() const;
+    vk::Extent3D getTextureExtent() const;
+    // a layer per camera unless layers is given
+    vk::UniqueImage createTextureArray(vk::Format format, uint32_t width,
+                                       uint32_t height,
+                                       vk::ImageUsageFlags usage,
+                                       vk::ImageLayout layout,
+                                       vk::UniqueDeviceMemory& memory,
+                                       uint32_t layers = 0);
+    vk::UniqueImage createTableImage(vk::Format format, int width, int height,
+                                     const std::vector<std::vector<float>>& layers,
+                                     vk::UniqueDeviceMemory& memory);
+    bool isBayer() const
+    {
+        return inputFormat == InputFormat::Bayer10 ||
+               inputFormat == InputFormat::Bayer12;
+    }
     void createTextureImage();
+    void createRemapImage();
+    void createSurroundImage();
+    void* createMappedStageBuffer(vk::DeviceSize size);
+    void* createImportedStageBuffer(vk::DeviceSize size);
     void createTextureImageView();
     void createTextureSampler();
+    uint32_t recordUploads(vk::CommandBuffer cmd);
+    void recordPlaceholders(vk::CommandBuffer cmd);
+    void createDemosaicPipeline();
+    void recordDemosaic(vk::CommandBuffer cmd, uint32_t layerMask);
+    void createComposePipeline();
+    vk::UniquePipeline createComposeVariant(const ComposeGroup& group);
+    void createComposeImage();
+    void recordCompose(vk::CommandBuffer cmd, uint32_t imageIndex);
+    void recordComposeDispatch(vk::CommandBuffer cmd);
+    void recordComposeBlit(vk::CommandBuffer cmd, uint32_t imageIndex,
+                           bool acquire);
+    void submitAsyncCompose(vk::CommandBuffer cmd, uint32_t imageIndex,
+                            uint32_t uploadWaitCount,
+                            const vk::Semaphore* uploadWaits,
+                            const vk::PipelineStageFlags* uploadWaitStages,
+                            const uint64_t* uploadWaitValues,
+                            vk::Fence fence);
+    void submitFrame(vk::Queue queue, vk::CommandBuffer cmd,
+                     uint32_t waitCount, const vk::Semaphore* waits,
+                     const vk::PipelineStageFlags* waitStages,
+                     const uint64_t* waitValues, uint32_t signalCount,
+                     const vk::Semaphore* signals,
+                     const uint64_t* signalValues, vk::Fence fence);
+    void createTimestampPool();
+    void beginComposeTime(vk::CommandBuffer cmd, Compose compose);
+    void endComposeTime(vk::CommandBuffer cmd);
+    void collectComposeTime();
+    BenchResult benchRun(Compose compose, int frames);
 
     uint32_t findMemoryType(uint32_t typeFilter,
                             vk::MemoryPropertyFlags properties);
 
+    // where a mesh lies in the window, the texture coordinates of its top
+    // left and bottom right corners, and the remap table baked into it
+    struct MeshCell
+    {
+        float x, y, w, h;
+        glm::vec2 topLeft, bottomRight;
+        int table;
+    };
+    std::vector<MeshCell> layoutMeshes() const;
+    void createVertices();
+    void updateVertexLayout();
     void createVertexBuffer();
     void createIndexBuffer();
     void createUniformBuffers();
-    void updateUniformBuffer(uint32_t currentImage);
+    void updateUniformBuffer(uint32_t currentFrame);
     void createDescriptorPool();
     void createDescriptorSets();
-    void createCommandBuffers(int index);
+    void createCommandBuffers();
+    void recordCommandBuffer(vk::CommandBuffer cmd, uint32_t imageIndex);
     void createSyncObjects();
 
     static void framebufferResizeCallback(GLFWwindow* window,
                                           int width, int height);
     void cleanupSwapChain();
-    void recreateSwapChain(int index);
+    void recreateSwapChain();
 };
 
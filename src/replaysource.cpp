@@ -0,0 +1,227 @@
+#include "replaysource.hpp"
+
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <stdexcept>
+#include <cstring>
+
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+class ReplaySource::Frame : public PixelBufferBase
+{
+public:
+    Frame(ReplaySource* owner_, const PixelBufferBase& base, int slot_) :
+        PixelBufferBase(base),
+        owner(owner_),
+        slot(slot_)
+    {}
+
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    ~Frame()
+    {
+        owner->release(slot);
+    }
+
+private:
+    ReplaySource* owner;
+    // -1 for a view of the mapping
+    int slot;
+};
+
+ReplaySource::ReplaySource(const std::vector<PixelBufferBase>& slots,
+                           std::shared_ptr<session::Reader> reader,
+                           int camera, double speed) :
+    m_slots(slots),
+    m_framePool(sizeof(Frame) + 64, slots.size()),
+    m_reader(reader),
+    m_entries(reader->getEntries(camera)),
+    m_camera(camera),
+    m_width(reader->getHeader().width),
+    m_height(reader->getHeader().height),
+    m_speed(speed),
+    m_firstTimestamp(reader->getFirstTimestamp()),
+    m_maxInFlight(slots.size())
+{
+    if (slots.empty() || speed < 0) {
+        throw std::runtime_error("invalid initialization params");
+    }
+    if (m_entries.empty()) {
+        throw std::runtime_error("session: no frames of camera " +
+                                 std::to_string(camera));
+    }
+    if (reader->getHeader().frameSize > slots[0].getLength()) {
+        throw std::runtime_error("session: frame does not fit the buffers");
+    }
+
+    // a loop lasts the session plus one frame interval of the first
+    // camera, the same for every camera so they stay in step
+    const std::vector<session::IndexEntry>& first = reader->getEntries(0);
+    int64_t interval = first.size() > 1 ?
+        (first.back().timestamp - first.front().timestamp) /
+            static_cast<int64_t>(first.size() - 1) :
+        33333;
+    m_periodUs = reader->getLastTimestamp() - m_firstTimestamp + interval;
+
+    if (m_speed > 0)
+        m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    else
+        m_fd = eventfd(m_maxInFlight, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_fd == -1) {
+        throw std::runtime_error("failed to create replay fd");
+    }
+}
+
+ReplaySource::~ReplaySource()
+{
+    ::close(m_fd);
+}
+
+std::vector<PixelBufferBase> ReplaySource::getFrameViews() const
+{
+    std::vector<PixelBufferBase> views;
+    views.reserve(m_entries.size());
+
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        void* data = const_cast<unsigned char*>(m_reader->getFrame(m_entries[i]));
+        views.push_back(PixelBufferBase(data, m_entries[i].length, m_width,
+                                        m_height, m_camera, i));
+    }
+
+    return views;
+}
+
+void ReplaySource::start()
+{
+    // a little ahead, so the first frames of all cameras are not late
+    m_startUs = monotonicUs() + 10000;
+    m_next = 0;
+    m_loop = 0;
+
+    if (m_speed > 0)
+        armTimer();
+}
+
+void ReplaySource::stop()
+{
+    if (m_speed > 0) {
+        struct itimerspec spec = {};
+        timerfd_settime(m_fd, 0, &spec, nullptr);
+    }
+}
+
+std::shared_ptr<PixelBufferBase> ReplaySource::dequeBuffer()
+{
+    // a tick of the timer, or one of the free frames
+    uint64_t count;
+    if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+        return nullptr;
+
+    int64_t timestamp;
+    if (m_speed > 0) {
+        // frames already overdue when their successor is due are skipped
+        int64_t now = monotonicUs();
+        for (;;) {
+            size_t pos = m_next + 1 == m_entries.size() ? 0 : m_next + 1;
+            uint64_t loop = pos ? m_loop : m_loop + 1;
+            if (dueUs(pos, loop) > now)
+                break;
+            advance();
+            m_dropCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        timestamp = dueUs(m_next, m_loop);
+
+        if (m_inFlight.load(std::memory_order_relaxed) >= m_maxInFlight) {
+            advance();
+            m_dropCount.fetch_add(1, std::memory_order_relaxed);
+            armTimer();
+            return nullptr;
+        }
+    } else {
+        timestamp = recordedUs(m_next, m_loop);
+    }
+
+    const session::IndexEntry& entry = m_entries[m_next];
+    const unsigned char* data = m_reader->getFrame(entry);
+    int slot = -1;
+    PixelBufferBase base;
+
+    if (m_zeroCopy) {
+        base = PixelBufferBase(const_cast<unsigned char*>(data), entry.length,
+                               m_width, m_height, m_camera, m_next);
+    } else {
+        // never fails, frames in flight are bounded by the slots
+        slot = m_slots.acquire();
+        if (slot == -1) {
+            throw std::runtime_error("replay: out of staging slots");
+        }
+        base = m_slots.at(slot);
+        std::memcpy(base.getStart(), data, entry.length);
+    }
+
+    m_inFlight.fetch_add(1, std::memory_order_relaxed);
+    auto frame = std::allocate_shared<Frame>(PoolAllocator<Frame>(&m_framePool),
+                                             this, base, slot);
+    frame->setTimestamp(timestamp, m_sequence++);
+
+    advance();
+    if (m_speed > 0)
+        armTimer();
+
+    return frame;
+}
+
+int64_t ReplaySource::recordedUs(size_t pos, uint64_t loop) const
+{
+    return m_entries[pos].timestamp - m_firstTimestamp +
+           static_cast<int64_t>(loop) * m_periodUs;
+}
+
+int64_t ReplaySource::dueUs(size_t pos, uint64_t loop) const
+{
+    return m_startUs + static_cast<int64_t>(recordedUs(pos, loop) / m_speed);
+}
+
+void ReplaySource::advance()
+{
+    if (++m_next == m_entries.size()) {
+        m_next = 0;
+        m_loop++;
+    }
+}
+
+void ReplaySource::armTimer()
+{
+    int64_t due = dueUs(m_next, m_loop);
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = due / 1000000;
+    spec.it_value.tv_nsec = due % 1000000 * 1000;
+
+    // a time already passed fires at once
+    if (timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr)) {
+        throw std::runtime_error("timerfd_settime failed");
+    }
+}
+
+// from whichever thread drops the last reference, usually the renderer
+void ReplaySource::release(int slot)
+{
+    if (slot != -1)
+        m_slots.release(slot);
+    m_inFlight.fetch_sub(1, std::memory_order_relaxed);
+
+    if (m_speed == 0) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(m_fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+#include "framepool.hpp"
+#include "slotpool.hpp"
+#include "framesource.hpp"
+#include "session.hpp"
+
+/*
+ * replays one camera of a session mapped by session::Reader. A frame is due
+ * at its recorded time divided by speed, a speed of 0 hands frames out as
+ * fast as the pipeline gives them back. Once the renderer uploads from the
+ * mapping (setZeroCopy) a frame is a view of the file, otherwise it is
+ * copied into a staging slot. The session loops, shifted by its length so
+ * that timestamps keep growing.
+ */
+class ReplaySource : public FrameSource
+{
+public:
+    ReplaySource(const std::vector<PixelBufferBase>& slots,
+                 std::shared_ptr<session::Reader> reader, int camera,
+                 double speed);
+    ReplaySource(const ReplaySource&) = delete;
+    ReplaySource& operator=(const ReplaySource&) = delete;
+    ~ReplaySource();
+
+    void start() override;
+    void stop() override;
+    // a timerfd armed for the next frame, an eventfd counting free frames
+    // when replaying as fast as possible
+    int getFd() const override { return m_fd; }
+    std::shared_ptr<PixelBufferBase> dequeBuffer() override;
+    uint64_t getHeapAllocCount() const override
+    {
+        return m_framePool.getHeapAllocCount();
+    }
+    // frames skipped to keep up with the recorded timing
+    uint64_t getDropCount() const override
+    {
+        return m_dropCount.load(std::memory_order_relaxed);
+    }
+
+    // every frame of the camera in the mapping, the subIndex of a view is
+    // its position in the session
+    std::vector<PixelBufferBase> getFrameViews() const;
+    // call before start()
+    void setZeroCopy(bool zeroCopy)
+    {
+        m_zeroCopy = zeroCopy;
+    }
+
+private:
+    class Frame;
+
+    SlotPool m_slots;
+    FramePool m_framePool;
+    std::shared_ptr<session::Reader> m_reader;
+    const std::vector<session::IndexEntry>& m_entries;
+    int m_camera;
+    int m_width;
+    int m_height;
+    double m_speed;
+    bool m_zeroCopy = false;
+    int m_fd = -1;
+
+    // the session's first timestamp replays at m_startUs
+    int64_t m_firstTimestamp;
+    int64_t m_periodUs;
+    int64_t m_startUs = 0;
+    size_t m_next = 0;
+    uint64_t m_loop = 0;
+    uint32_t m_sequence = 0;
+
+    const int m_maxInFlight;
+    std::atomic<int> m_inFlight{0};
+    std::atomic<uint64_t> m_dropCount{0};
+
+    int64_t dueUs(size_t pos, uint64_t loop) const;
+    int64_t recordedUs(size_t pos, uint64_t loop) const;
+    void advance();
+    void armTimer();
+    void release(int slot);
+};
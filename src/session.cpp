@@ -0,0 +1,90 @@
+#include "session.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+namespace session {
+Reader::Reader(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw std::runtime_error("failed to open: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || static_cast<uint64_t>(st.st_size) < 2 * blockSize ||
+        st.st_size % blockSize) {
+        ::close(fd);
+        throw std::runtime_error(path + ": not a session");
+    }
+    m_size = st.st_size;
+
+    // the mapping keeps the file referenced
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(path + ": failed to mmap");
+    }
+    m_data = static_cast<unsigned char*>(data);
+
+    try {
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+        if (std::memcmp(m_header.magic, fileMagic, sizeof(fileMagic)) ||
+            m_header.version != version) {
+            throw std::runtime_error(path + ": not a session");
+        }
+        if (m_header.cameraNum == 0 || m_header.frameSize == 0) {
+            throw std::runtime_error(path + ": bad session header");
+        }
+
+        Trailer trailer;
+        std::memcpy(&trailer, m_data + m_size - sizeof(trailer), sizeof(trailer));
+        if (std::memcmp(trailer.magic, trailerMagic, sizeof(trailerMagic)) ||
+            trailer.indexOffset % blockSize ||
+            trailer.indexOffset + trailer.entryCount * sizeof(IndexEntry) >
+                m_size - sizeof(trailer)) {
+            throw std::runtime_error(path + ": session incomplete, no index");
+        }
+
+        m_firstTimestamp = std::numeric_limits<int64_t>::max();
+        m_lastTimestamp = std::numeric_limits<int64_t>::min();
+        m_entries.resize(m_header.cameraNum);
+        for (uint64_t i = 0; i < trailer.entryCount; i++) {
+            IndexEntry entry;
+            std::memcpy(&entry, m_data + trailer.indexOffset + i * sizeof(entry),
+                        sizeof(entry));
+            if (entry.camera >= m_header.cameraNum ||
+                entry.offset % blockSize ||
+                entry.length != m_header.frameSize ||
+                entry.offset + entry.length > trailer.indexOffset) {
+                throw std::runtime_error(path + ": bad index entry");
+            }
+            m_entries[entry.camera].push_back(entry);
+            m_firstTimestamp = std::min(m_firstTimestamp, entry.timestamp);
+            m_lastTimestamp = std::max(m_lastTimestamp, entry.timestamp);
+        }
+        if (!trailer.entryCount) {
+            throw std::runtime_error(path + ": session is empty");
+        }
+
+        // replay reads the frames in order
+        madvise(m_data, m_size, MADV_SEQUENTIAL);
+    } catch (...) {
+        munmap(m_data, m_size);
+        throw;
+    }
+}
+
+Reader::~Reader()
+{
+    munmap(m_data, m_size);
+}
+}
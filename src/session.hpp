@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * recorded capture session, one file for all cameras, little endian:
+ *
+ *   FileHeader                   padded to blockSize
+ *   record 0 ... record n-1      in the order the frames arrived
+ *   IndexEntry[n]                followed by the Trailer, together padded
+ *                                to blockSize with the Trailer at the end
+ *
+ * a record is a RecordHeader padded to blockSize followed by the frame,
+ * padded to blockSize as well. Frames thus start block aligned in the file,
+ * which lets them be written with O_DIRECT and mapped without a copy. The
+ * index is written last, a file without a valid trailer is incomplete.
+ */
+namespace session {
+    const uint64_t blockSize = 4096;
+    const char fileMagic[8] = {'F', 'E', 'Y', 'E', 'S', 'E', 'S', '1'};
+    const char trailerMagic[8] = {'F', 'E', 'Y', 'E', 'I', 'D', 'X', '1'};
+    const uint32_t recordMagic = 0x31434552; // "REC1"
+    const uint32_t version = 1;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        // v4l2 fourcc of the recorded frames, never compressed
+        uint32_t pixelFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t cameraNum;
+        // of every frame, tightly packed
+        uint32_t frameSize;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t camera;
+        // CLOCK_MONOTONIC, microseconds
+        int64_t timestamp;
+        uint32_t sequence;
+        uint32_t length;
+    };
+
+    struct IndexEntry
+    {
+        // of the frame, not of its RecordHeader
+        uint64_t offset;
+        int64_t timestamp;
+        uint32_t camera;
+        uint32_t sequence;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    struct Trailer
+    {
+        uint64_t indexOffset;
+        uint64_t entryCount;
+        char magic[8];
+        uint64_t reserved;
+    };
+
+    static_assert(sizeof(IndexEntry) == 32, "IndexEntry layout");
+    static_assert(sizeof(Trailer) == 32, "Trailer layout");
+
+    inline uint64_t alignUp(uint64_t n)
+    {
+        return (n + blockSize - 1) & ~(blockSize - 1);
+    }
+
+    /*
+     * maps the whole file read-only, frames are read in place at the
+     * offsets of the index
+     */
+    class Reader
+    {
+    public:
+        explicit Reader(const std::string& path);
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader();
+
+        const FileHeader& getHeader() const { return m_header; }
+        // one camera's frames in recording order
+        const std::vector<IndexEntry>& getEntries(int camera) const
+        {
+            return m_entries.at(camera);
+        }
+        // the mapping, block aligned and a whole number of blocks long
+        unsigned char* getData() const { return m_data; }
+        uint64_t getSize() const { return m_size; }
+        const unsigned char* getFrame(const IndexEntry& entry) const
+        {
+            return m_data + entry.offset;
+        }
+        // over all cameras
+        int64_t getFirstTimestamp() const { return m_firstTimestamp; }
+        int64_t getLastTimestamp() const { return m_lastTimestamp; }
+
+    private:
+        unsigned char* m_data = nullptr;
+        uint64_t m_size = 0;
+        FileHeader m_header;
+        std::vector<std::vector<IndexEntry>> m_entries;
+        int64_t m_firstTimestamp = 0;
+        int64_t m_lastTimestamp = 0;
+    };
+}
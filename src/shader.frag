@@ -1,13 +1,31 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 1) uniform sampler2DArray texSampler;
+#include "frame.glsl"
+
+// lens correction through the remap tables
+layout(constant_id = 1) const int remap = 0;
+// the top view of all cameras, fragTexCoord spans the surround table
+layout(constant_id = 2) const int surround = 0;
+
+// frame texture coordinates per pixel of the corrected view, unused
+// without remap
+layout(binding = 3) uniform sampler2DArray remapSampler;
 
 layout(location = 0) in vec3 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
-}
+    if (surround != 0) {
+        outColor = sampleSurround(fragTexCoord.xy);
+        return;
+    }
 
+    vec3 texCoord = fragTexCoord;
+    if (remap != 0)
+        texCoord.xy = texture(remapSampler, fragTexCoord).rg;
+
+    outColor = sampleFrame(texCoord, remap != 0);
+}
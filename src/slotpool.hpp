@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "message.hpp"
+#include "framepool.hpp"
+
+/*
+ * a camera's staging slots for producers that fill them on the cpu. A slot
+ * is handed out as a frame whose last reference, usually dropped by the
+ * renderer after the upload, gives the slot back.
+ */
+class SlotPool
+{
+public:
+    explicit SlotPool(const std::vector<PixelBufferBase>& slots_) :
+        slots(slots_),
+        framePool(sizeof(Frame) + 64, slots_.size())
+    {
+        freeSlots.reserve(slots.size());
+        for (size_t i = 0; i < slots.size(); i++) {
+            freeSlots.push_back(i);
+        }
+    }
+
+    SlotPool(const SlotPool&) = delete;
+    SlotPool& operator=(const SlotPool&) = delete;
+
+    // -1 when every slot is in use
+    int acquire()
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (freeSlots.empty())
+            return -1;
+
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+
+        return slot;
+    }
+
+    // for a slot that was acquired but not filled
+    void release(int slot)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        freeSlots.push_back(slot);
+    }
+
+    const PixelBufferBase& at(int slot) const
+    {
+        return slots.at(slot);
+    }
+
+    // takes over an acquired slot
+    std::shared_ptr<PixelBufferBase> wrap(int slot)
+    {
+        return std::allocate_shared<Frame>(PoolAllocator<Frame>(&framePool),
+                                           this, slots.at(slot));
+    }
+
+    uint64_t getHeapAllocCount() const
+    {
+        return framePool.getHeapAllocCount();
+    }
+
+private:
+    class Frame : public PixelBufferBase
+    {
+    public:
+        Frame(SlotPool* owner_, const PixelBufferBase& slot) :
+            PixelBufferBase(slot),
+            owner(owner_)
+        {}
+
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        ~Frame()
+        {
+            owner->release(getSubIndex());
+        }
+
+    private:
+        SlotPool* owner;
+    };
+
+    std::vector<PixelBufferBase> slots;
+    std::mutex m;
+    std::vector<int> freeSlots;
+    FramePool framePool;
+};
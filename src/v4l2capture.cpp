@@ -5,33 +5,259 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
 
 namespace v4l2 {
+int bytesPerLine(enum PixFormat pixFormat, int width)
+{
+    switch (pixFormat) {
+    case PixFormat::XBGR32:
+        return width * 4;
+    case PixFormat::YUYV:
+    case PixFormat::SRGGB10:
+    case PixFormat::SGRBG10:
+    case PixFormat::SGBRG10:
+    case PixFormat::SBGGR10:
+    case PixFormat::SRGGB12:
+    case PixFormat::SGRBG12:
+    case PixFormat::SGBRG12:
+    case PixFormat::SBGGR12:
+        return width * 2;
+    case PixFormat::NV12:
+        return width;
+    case PixFormat::MJPEG:
+        return 0;
+    }
+
+    return 0;
+}
+
+int frameSize(enum PixFormat pixFormat, int width, int height)
+{
+    switch (pixFormat) {
+    case PixFormat::NV12:
+        return width * height * 3 / 2;
+    default:
+        return bytesPerLine(pixFormat, width) * height;
+    }
+}
+
+Mappings::~Mappings()
+{
+    for (const auto& area : areas) {
+        munmap(area.first, area.second);
+    }
+}
+
 Capture::~Capture()
 {
-    if (m_fd != -1)
+    close();
+}
+
+void Capture::close()
+{
+    for (int fd : m_dmaBufFds) {
+        ::close(fd);
+    }
+    m_dmaBufFds.clear();
+
+    // frames still held keep their buffers mapped
+    m_mappings.reset();
+    m_buffers.clear();
+
+    if (m_fd != -1) {
+        struct v4l2_requestbuffers req = {};
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        req.count = 0;
+        req.memory = m_memory;
+        ioctl(m_fd, VIDIOC_REQBUFS, &req);
+
         ::close(m_fd);
+        m_fd = -1;
+    }
 }
 
 void Capture::open(const std::string &path, enum PixFormat pixFormat,
                    const std::vector<PixelBufferBase>& buffers)
 {
-    int ret;
-
     if (buffers.size() < 2 ||
         buffers[0].getWidth() <= 0 ||
         buffers[0].getHeight() <= 0) {
         throw std::runtime_error("invalid initialization params");
     }
 
-    m_width = buffers[0].getWidth();
-    m_height = buffers[0].getHeight();
-    m_pixFmt = static_cast<uint32_t>(pixFormat);
+    m_path = path;
+    m_mode = Mode::UserPtr;
+    m_pixFormat = pixFormat;
+    m_userBuffers = buffers;
     m_bufferNum = buffers.size();
+    m_memory = V4L2_MEMORY_USERPTR;
+
+    openDevice(path, pixFormat, buffers[0].getWidth(), buffers[0].getHeight());
+
+    // the driver writes whole frames into memory sized and laid out for
+    // the negotiated format
+    if (m_bytesPerLine != bytesPerLine(pixFormat, m_width) ||
+        m_frameSize > buffers[0].getLength()) {
+        throw std::runtime_error(path + ": frame does not fit the buffers");
+    }
+
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    req.count = m_bufferNum;
+    req.memory = V4L2_MEMORY_USERPTR;
+    if (ioctl(m_fd, VIDIOC_REQBUFS, &req)) {
+        throw std::runtime_error("do not support V4L2_MEMORY_USERPTR");
+    }
+    if (req.count < 2) {
+        throw std::runtime_error("Insufficient buffer memory");
+    }
+
+    m_buffers = buffers;
+    createFramePool();
+
+    for (int i = 0; i < m_buffers.size(); i++) {
+        doneFrame(i);
+    }
+}
+
+std::vector<PixelBufferBase> Capture::openExported(const std::string &path,
+                                                   enum PixFormat pixFormat,
+                                                   int width, int height,
+                                                   int bufferNum, int camIndex)
+{
+    if (bufferNum < 2 || width <= 0 || height <= 0) {
+        throw std::runtime_error("invalid initialization params");
+    }
+
+    m_path = path;
+    m_mode = Mode::Exported;
+    m_pixFormat = pixFormat;
+    m_requestedBufferNum = bufferNum;
+    m_camIndex = camIndex;
+    m_memory = V4L2_MEMORY_MMAP;
+
+    openDevice(path, pixFormat, width, height);
+
+    // imported buffers are copied tightly packed, padded lines can not be
+    // described to the upload
+    if (m_bytesPerLine != bytesPerLine(pixFormat, width)) {
+        throw std::runtime_error(path + ": padded lines, can not export");
+    }
+
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    req.count = bufferNum;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(m_fd, VIDIOC_REQBUFS, &req)) {
+        throw std::runtime_error("do not support V4L2_MEMORY_MMAP");
+    }
+    if (req.count < 2) {
+        throw std::runtime_error("Insufficient buffer memory");
+    }
+    m_bufferNum = req.count;
+
+    mapBuffers(path, camIndex, true);
+    createFramePool();
+
+    for (int i = 0; i < m_bufferNum; i++) {
+        doneFrame(i);
+    }
+
+    return m_buffers;
+}
+
+void Capture::openCompressed(const std::string &path, enum PixFormat pixFormat,
+                             int width, int height, int bufferNum,
+                             int camIndex)
+{
+    if (bufferNum < 2 || width <= 0 || height <= 0) {
+        throw std::runtime_error("invalid initialization params");
+    }
+
+    m_path = path;
+    m_mode = Mode::Compressed;
+    m_pixFormat = pixFormat;
+    m_requestedBufferNum = bufferNum;
+    m_camIndex = camIndex;
+    m_memory = V4L2_MEMORY_MMAP;
+
+    openDevice(path, pixFormat, width, height);
+
+    struct v4l2_requestbuffers req = {};
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    req.count = bufferNum;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(m_fd, VIDIOC_REQBUFS, &req)) {
+        throw std::runtime_error("do not support V4L2_MEMORY_MMAP");
+    }
+    if (req.count < 2) {
+        throw std::runtime_error("Insufficient buffer memory");
+    }
+    m_bufferNum = req.count;
+
+    mapBuffers(path, camIndex, false);
+    createFramePool();
+
+    for (int i = 0; i < m_bufferNum; i++) {
+        doneFrame(i);
+    }
+}
+
+// m_buffers become read-only mappings of the driver's buffers
+void Capture::mapBuffers(const std::string &path, int camIndex, bool exportFds)
+{
+    m_mappings = std::make_shared<Mappings>();
+
+    for (int i = 0; i < m_bufferNum; i++) {
+        struct v4l2_buffer buf = {};
+        struct v4l2_plane plane = {};
+
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        buf.m.planes = &plane;
+        buf.length = 1;
+        if (ioctl(m_fd, VIDIOC_QUERYBUF, &buf)) {
+            throw std::runtime_error("VIDIOC_QUERYBUF error");
+        }
+
+        void* start = mmap(nullptr, plane.length, PROT_READ, MAP_SHARED,
+                           m_fd, plane.m.mem_offset);
+        if (start == MAP_FAILED) {
+            throw std::runtime_error("failed to mmap buffer");
+        }
+        m_mappings->areas.emplace_back(start, plane.length);
+        m_buffers.push_back(PixelBufferBase(start, plane.length, m_width,
+                                            m_height, camIndex, i));
+
+        if (!exportFds)
+            continue;
+
+        struct v4l2_exportbuffer expbuf = {};
+        expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        expbuf.index = i;
+        expbuf.plane = 0;
+        expbuf.flags = O_RDONLY | O_CLOEXEC;
+        if (ioctl(m_fd, VIDIOC_EXPBUF, &expbuf)) {
+            throw std::runtime_error(path + ": do not support VIDIOC_EXPBUF");
+        }
+        m_dmaBufFds.push_back(expbuf.fd);
+    }
+}
+
+void Capture::openDevice(const std::string &path, enum PixFormat pixFormat,
+                         int width, int height)
+{
+    int ret;
+
+    m_width = width;
+    m_height = height;
+    m_pixFmt = static_cast<uint32_t>(pixFormat);
 
     m_fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
     if (m_fd == -1) {
@@ -46,6 +272,13 @@ void Capture::open(const std::string &path, enum PixFormat pixFormat,
 
     enumFormat();
 
+    if (m_crop.width > 0) {
+        if (m_crop.width != width || m_crop.height != height) {
+            throw std::runtime_error(path + ": frame size is not the crop size");
+        }
+        setCropSelection(path);
+    }
+
     struct v4l2_format fmt = {};
     fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     fmt.fmt.pix_mp.width = m_width;
@@ -71,7 +304,18 @@ void Capture::open(const std::string &path, enum PixFormat pixFormat,
               << static_cast<char>(fmt.fmt.pix_mp.pixelformat >> 16 & 0xff)
               << static_cast<char>(fmt.fmt.pix_mp.pixelformat >> 24 & 0xff)
               << std::endl;
+    // drivers fall back to a format of their own choice
+    if (fmt.fmt.pix_mp.pixelformat != m_pixFmt ||
+        fmt.fmt.pix_mp.width != static_cast<uint32_t>(m_width) ||
+        fmt.fmt.pix_mp.height != static_cast<uint32_t>(m_height)) {
+        throw std::runtime_error(path + ": format not supported");
+    }
+    // some drivers reset the crop rectangle along with the format
+    if (m_crop.width > 0 && !cropKept()) {
+        throw std::runtime_error(path + ": crop reset by the format");
+    }
     m_frameSize =fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
+    m_bytesPerLine = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
 
     struct v4l2_streamparm parm = {};
     parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
@@ -80,38 +324,64 @@ void Capture::open(const std::string &path, enum PixFormat pixFormat,
     }
     std::cout << "\tfps: " << parm.parm.capture.timeperframe.denominator
               << std::endl;
+}
 
-    struct v4l2_requestbuffers req = {};
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    req.count = m_bufferNum;
-    req.memory = V4L2_MEMORY_USERPTR;
-    if (ioctl(m_fd, VIDIOC_REQBUFS, &req)) {
-        throw std::runtime_error("do not support V4L2_MEMORY_USERPTR");
+/*
+ * the driver may round the rectangle to what the sensor can do, a frame of
+ * another size or at another place would not fit the renderer's layout, so
+ * that is an error naming the rectangle it chose
+ */
+void Capture::setCropSelection(const std::string &path)
+{
+    // selections take the single planar type, multi-planar drivers accept
+    // it as well
+    struct v4l2_selection sel = {};
+    sel.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sel.target = V4L2_SEL_TGT_CROP_BOUNDS;
+    if (ioctl(m_fd, VIDIOC_G_SELECTION, &sel)) {
+        throw std::runtime_error(path + ": do not support cropping");
     }
-    if (req.count < 2) {
-        throw std::runtime_error("Insufficient buffer memory");
+    if (m_crop.left < sel.r.left || m_crop.top < sel.r.top ||
+        m_crop.left + m_crop.width > sel.r.left + static_cast<int>(sel.r.width) ||
+        m_crop.top + m_crop.height > sel.r.top + static_cast<int>(sel.r.height)) {
+        throw std::runtime_error(path + ": crop outside the sensor, bounds " +
+                                 std::to_string(sel.r.width) + "x" +
+                                 std::to_string(sel.r.height));
     }
 
-    m_buffers = buffers;
-
-    for (int i = 0; i < m_buffers.size(); i++) {
-        struct v4l2_buffer buf = {};
-        struct v4l2_plane plane = {};
-
-        plane.length = m_buffers.at(i).getLength();
-        plane.m.userptr = reinterpret_cast<unsigned long>(m_buffers.at(i).getStart());
-
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-        buf.memory = V4L2_MEMORY_USERPTR;
-        buf.index = i;
-        buf.m.planes = &plane;
-        buf.length = 1;
+    sel.target = V4L2_SEL_TGT_CROP;
+    sel.r.left = m_crop.left;
+    sel.r.top = m_crop.top;
+    sel.r.width = m_crop.width;
+    sel.r.height = m_crop.height;
+    if (ioctl(m_fd, VIDIOC_S_SELECTION, &sel)) {
+        throw std::runtime_error(path + ": VIDIOC_S_SELECTION failed");
+    }
 
-        if (ioctl(m_fd, VIDIOC_QBUF, &buf)) {
-            std::cout << errno << std::endl;
-            throw std::runtime_error("VIDIOC_QBUF error");
-        }
+    if (sel.r.left != m_crop.left || sel.r.top != m_crop.top ||
+        sel.r.width != static_cast<uint32_t>(m_crop.width) ||
+        sel.r.height != static_cast<uint32_t>(m_crop.height)) {
+        throw std::runtime_error(path + ": crop adjusted by the driver to " +
+                                 std::to_string(sel.r.width) + "x" +
+                                 std::to_string(sel.r.height) + "+" +
+                                 std::to_string(sel.r.left) + "+" +
+                                 std::to_string(sel.r.top));
     }
+    std::cout << "\tcrop: " << m_crop.width << "x" << m_crop.height
+              << "+" << m_crop.left << "+" << m_crop.top << std::endl;
+}
+
+bool Capture::cropKept() const
+{
+    struct v4l2_selection sel = {};
+    sel.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sel.target = V4L2_SEL_TGT_CROP;
+    if (ioctl(m_fd, VIDIOC_G_SELECTION, &sel))
+        return false;
+
+    return sel.r.left == m_crop.left && sel.r.top == m_crop.top &&
+           sel.r.width == static_cast<uint32_t>(m_crop.width) &&
+           sel.r.height == static_cast<uint32_t>(m_crop.height);
 }
 
 void Capture::start()
@@ -120,6 +390,8 @@ void Capture::start()
     if (ioctl(m_fd, VIDIOC_STREAMON, &type)) {
         throw std::runtime_error("VIDIOC_STREAMON error");
     }
+    // the driver counts from 0 again
+    m_sequenced = false;
 }
 
 void Capture::stop()
@@ -131,13 +403,13 @@ void Capture::stop()
     }
 }
 
-int Capture::readFrame()
+int Capture::readFrame(FrameInfo* info)
 {
     struct v4l2_buffer buf = {};
     struct v4l2_plane plane = {};
 
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    buf.memory = V4L2_MEMORY_USERPTR;
+    buf.memory = m_memory;
     buf.length = 1;
     buf.m.planes = &plane;
 
@@ -149,6 +421,13 @@ int Capture::readFrame()
                                      std::to_string(errno));
     }
 
+    if (info) {
+        info->timestamp = buf.timestamp.tv_sec * 1000000LL +
+                          buf.timestamp.tv_usec;
+        info->sequence = buf.sequence;
+        info->bytesUsed = plane.bytesused;
+    }
+
     return buf.index;
 }
 
@@ -157,29 +436,116 @@ void Capture::doneFrame(int index)
     struct v4l2_buffer buf = {};
     struct v4l2_plane plane = {};
 
-    plane.length = m_buffers.at(index).getLength();
-    plane.m.userptr = reinterpret_cast<unsigned long>(m_buffers.at(index).getStart());
+    if (m_memory == V4L2_MEMORY_USERPTR) {
+        plane.length = m_buffers.at(index).getLength();
+        plane.m.userptr = reinterpret_cast<unsigned long>(m_buffers.at(index).getStart());
+    }
 
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    buf.memory = V4L2_MEMORY_USERPTR;
+    buf.memory = m_memory;
     buf.index = index;
     buf.m.planes = &plane;
     buf.length = 1;
 
     if (ioctl(m_fd, VIDIOC_QBUF, &buf)) {
-        throw std::runtime_error("VIDIOC_QBUF error");
+        throw std::runtime_error("VIDIOC_QBUF error: " + std::to_string(errno));
     }
+}
 
+void Capture::releaseFrame(int index, uint32_t generation)
+{
+    std::lock_guard<std::mutex> lk(m_queueLock);
+    if (generation != m_generation)
+        return;
+
+    // called from whichever thread drops the frame, often in a destructor
+    try {
+        doneFrame(index);
+    } catch (const std::exception&) {
+    }
 }
 
-std::shared_ptr<Buffer> Capture::dequeBuffer()
+void Capture::reopen()
 {
-    int index = readFrame();
+    {
+        std::lock_guard<std::mutex> lk(m_queueLock);
+        m_generation++;
+    }
+
+    // the stream may be half dead already, errors do not matter here
+    if (m_fd != -1) {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        ioctl(m_fd, VIDIOC_STREAMOFF, &type);
+    }
+    close();
+
+    try {
+        switch (m_mode) {
+        case Mode::UserPtr:
+            open(m_path, m_pixFormat, m_userBuffers);
+            break;
+        case Mode::Exported:
+            openExported(m_path, m_pixFormat, m_width, m_height,
+                         m_requestedBufferNum, m_camIndex);
+            break;
+        case Mode::Compressed:
+            openCompressed(m_path, m_pixFormat, m_width, m_height,
+                           m_requestedBufferNum, m_camIndex);
+            break;
+        }
+        start();
+    } catch (...) {
+        // the next attempt starts from a closed device again
+        close();
+        throw;
+    }
+}
+
+std::shared_ptr<PixelBufferBase> Capture::dequeBuffer()
+{
+    FrameInfo info;
+    int index = readFrame(&info);
 
     if (index == -1)
-        return std::make_shared<Buffer>();
+        return nullptr;
+
+    if (m_sequenced)
+        m_dropCount.fetch_add(info.sequence - m_lastSequence - 1,
+                              std::memory_order_relaxed);
+    m_sequenced = true;
+    m_lastSequence = info.sequence;
+
+    PixelBufferBase frame = m_buffers[index];
+    if (m_pixFmt == V4L2_PIX_FMT_MJPEG) {
+        frame = PixelBufferBase(frame.getStart(), info.bytesUsed,
+                                frame.getWidth(), frame.getHeight(),
+                                frame.getIndex(), frame.getSubIndex());
+    }
+
+    auto buf = std::allocate_shared<Buffer>(PoolAllocator<Buffer>(m_framePool.get()),
+                                            this, frame, m_generation,
+                                            m_mappings);
+    buf->setTimestamp(info.timestamp, info.sequence);
 
-    return std::make_shared<Buffer>(this, m_buffers[index]);
+    return buf;
+}
+
+void Capture::createFramePool()
+{
+    // a buffer can only be dequeued once until it is queued again, so
+    // there are never more live frames than buffers. A block holds the
+    // Buffer and the shared_ptr control block.
+    if (m_framePool && m_framePool->getBlockNum() == m_buffers.size())
+        return;
+
+    // after a reopen with another buffer count, frames from before may
+    // still be out and go back to the old pool, which lives as long as we do
+    std::lock_guard<std::mutex> lk(m_poolLock);
+    if (m_framePool) {
+        m_retiredHeapAllocs += m_framePool->getHeapAllocCount();
+        m_retiredPools.push_back(std::move(m_framePool));
+    }
+    m_framePool.reset(new FramePool(sizeof(Buffer) + 64, m_buffers.size()));
 }
 
 void Capture::enumFormat() const
@@ -4,19 +4,75 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <utility>
+#include <atomic>
+#include <mutex>
 
 #include <linux/videodev2.h>
 
 #include "message.hpp"
+#include "framepool.hpp"
+#include "framesource.hpp"
 
 namespace v4l2 {
     enum class PixFormat
     {
         XBGR32 = V4L2_PIX_FMT_XBGR32,
+        // 4:2:2 packed, Y0 Cb Y1 Cr
+        YUYV = V4L2_PIX_FMT_YUYV,
+        // 4:2:0, Y plane followed by an interleaved CbCr plane
+        NV12 = V4L2_PIX_FMT_NV12,
+        // raw bayer, one little endian 16 bit word per sample, named by
+        // the order of the first 2x2 cell
+        SRGGB10 = V4L2_PIX_FMT_SRGGB10,
+        SGRBG10 = V4L2_PIX_FMT_SGRBG10,
+        SGBRG10 = V4L2_PIX_FMT_SGBRG10,
+        SBGGR10 = V4L2_PIX_FMT_SBGGR10,
+        SRGGB12 = V4L2_PIX_FMT_SRGGB12,
+        SGRBG12 = V4L2_PIX_FMT_SGRBG12,
+        SGBRG12 = V4L2_PIX_FMT_SGBRG12,
+        SBGGR12 = V4L2_PIX_FMT_SBGGR12,
+        // compressed, frames vary in size and are decoded on the cpu
+        MJPEG = V4L2_PIX_FMT_MJPEG,
+    };
+
+    // of the first plane, tightly packed
+    int bytesPerLine(enum PixFormat pixFormat, int width);
+    // of a tightly packed frame, all planes
+    int frameSize(enum PixFormat pixFormat, int width, int height);
+
+    // a region of the sensor, in its pixels
+    struct Rect
+    {
+        int left = 0;
+        int top = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct FrameInfo
+    {
+        // CLOCK_MONOTONIC, microseconds
+        int64_t timestamp;
+        uint32_t sequence;
+        // less than the buffer for compressed frames
+        uint32_t bytesUsed;
+    };
+
+    // the driver's buffers mapped into our address space, unmapped once the
+    // capture and every frame dequeued from them let go
+    struct Mappings
+    {
+        std::vector<std::pair<void*, size_t>> areas;
+
+        Mappings() = default;
+        Mappings(const Mappings&) = delete;
+        Mappings& operator=(const Mappings&) = delete;
+        ~Mappings();
     };
 
     class Buffer;
-    class Capture
+    class Capture : public FrameSource
     {
     public:
         Capture() = default;
@@ -24,24 +80,110 @@ namespace v4l2 {
         Capture& operator=(const Capture&) = delete;
         virtual ~Capture();
 
+        // capture only this region of the sensor (VIDIOC_S_SELECTION), the
+        // frames then are its size. Call it before opening, a width of 0
+        // captures the whole sensor
+        void setCrop(const Rect& crop)
+        {
+            m_crop = crop;
+        }
+        const Rect& getCrop() const
+        {
+            return m_crop;
+        }
+
+        // capture into caller provided memory (V4L2_MEMORY_USERPTR)
         void open(const std::string &path, enum PixFormat pixFormat,
                   const std::vector<PixelBufferBase>& buffers);
-        void start();
-        void stop();
-        int readFrame();
+        // capture into driver memory exported as dma-buf, the returned
+        // buffers are read-only mappings of it
+        std::vector<PixelBufferBase> openExported(const std::string &path,
+                                                  enum PixFormat pixFormat,
+                                                  int width, int height,
+                                                  int bufferNum, int camIndex);
+        // capture compressed frames into driver memory, handed out read-only
+        // with the length of the frame, not of the buffer
+        void openCompressed(const std::string &path, enum PixFormat pixFormat,
+                            int width, int height, int bufferNum, int camIndex);
+        void close();
+        void start() override;
+        void stop() override;
+        // -1 when no frame is ready
+        int readFrame(FrameInfo* info = nullptr);
         void doneFrame(int index);
-        int getFd() const { return m_fd; }
-        std::shared_ptr<Buffer> dequeBuffer();
+        // queues a dequeued frame again unless the device was reopened since,
+        // never throws, a failing device shows on the next dequeue
+        void releaseFrame(int index, uint32_t generation);
+        /*
+         * after a failure: closes the device and opens it again the way it
+         * was opened before, then starts streaming. Frames still held from
+         * before are not queued again. Throws while the device is not back
+         */
+        void reopen() override;
+        bool canReopen() const override { return !m_path.empty(); }
+        int getFd() const override { return m_fd; }
+        uint64_t getHeapAllocCount() const override
+        {
+            std::lock_guard<std::mutex> lk(m_poolLock);
+            return m_retiredHeapAllocs +
+                   (m_framePool ? m_framePool->getHeapAllocCount() : 0);
+        }
+        // gaps in the driver's sequence numbers
+        uint64_t getDropCount() const override
+        {
+            return m_dropCount.load(std::memory_order_relaxed);
+        }
+        const std::vector<int>& getDmaBufFds() const { return m_dmaBufFds; }
+        const std::vector<PixelBufferBase>& getBuffers() const { return m_buffers; }
+        std::shared_ptr<PixelBufferBase> dequeBuffer() override;
 
     private:
+        enum class Mode
+        {
+            UserPtr,
+            Exported,
+            Compressed,
+        };
+
         int m_fd = -1;
+        // what reopen() repeats
+        std::string m_path;
+        Mode m_mode = Mode::UserPtr;
+        enum PixFormat m_pixFormat;
+        int m_requestedBufferNum = 0;
+        int m_camIndex = 0;
+        std::vector<PixelBufferBase> m_userBuffers;
+        Rect m_crop;
+
         int m_width;
         int m_height;
         int m_frameSize;
+        int m_bytesPerLine;
         uint32_t m_pixFmt;
         int m_bufferNum;
+        uint32_t m_memory = V4L2_MEMORY_USERPTR;
         std::vector<PixelBufferBase> m_buffers;
-
+        std::vector<int> m_dmaBufFds;
+        std::shared_ptr<Mappings> m_mappings;
+        std::unique_ptr<FramePool> m_framePool;
+        std::vector<std::unique_ptr<FramePool>> m_retiredPools;
+        uint64_t m_retiredHeapAllocs = 0;
+        // the pool is only replaced on the capture side, this keeps the
+        // statistics from reading it meanwhile
+        mutable std::mutex m_poolLock;
+        // bumped by reopen(), frames of an older one are not queued again
+        std::mutex m_queueLock;
+        uint32_t m_generation = 0;
+        bool m_sequenced = false;
+        uint32_t m_lastSequence = 0;
+        std::atomic<uint64_t> m_dropCount{0};
+
+        void openDevice(const std::string &path, enum PixFormat pixFormat,
+                        int width, int height);
+        void mapBuffers(const std::string &path, int camIndex, bool exportFds);
+        void setCropSelection(const std::string &path);
+        bool cropKept() const;
+        void createFramePool();
         void enumFormat() const;
     };
 
@@ -53,15 +195,20 @@ namespace v4l2 {
 
         Buffer() = default;
 
-        Buffer(Capture* cap_, const PixelBufferBase& bufBase) :
+        Buffer(Capture* cap_, const PixelBufferBase& bufBase,
+               uint32_t generation_, std::shared_ptr<Mappings> mappings_) :
+            PixelBufferBase(bufBase),
             cap(cap_),
-            PixelBufferBase(bufBase)
+            generation(generation_),
+            mappings(std::move(mappings_))
         {
         }
 
         Buffer(Buffer&& other) :
             PixelBufferBase(other),
-            cap(std::exchange(other.cap, nullptr))
+            cap(std::exchange(other.cap, nullptr)),
+            generation(other.generation),
+            mappings(std::move(other.mappings))
         {
         }
 
@@ -70,6 +217,8 @@ namespace v4l2 {
             if (this != &other) {
                 release();
                 cap = std::exchange(other.cap, nullptr);
+                generation = other.generation;
+                mappings = std::move(other.mappings);
             }
 
             return *this;
@@ -82,11 +231,14 @@ namespace v4l2 {
 
     private:
         Capture* cap = nullptr;
+        uint32_t generation = 0;
+        // keeps driver memory mapped while the frame is read
+        std::shared_ptr<Mappings> mappings;
 
         void release()
         {
             if (cap)
-                cap->doneFrame(getSubIndex());
+                cap->releaseFrame(getSubIndex(), generation);
             cap = nullptr;
         }
     };
@@ -0,0 +1,224 @@
+/*
+ * a frame handed out by a source and dropped again must not touch the heap
+ * once the source is set up. operator new is replaced to count every
+ * allocation made while a cycle runs
+ */
+#include "framepool.hpp"
+#include "slotpool.hpp"
+#include "replaysource.hpp"
+#include "session.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<bool> counting{false};
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+// out of line, gcc takes the free for a mismatch with the builtin new
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// operator new calls made by f
+template<typename Func>
+static uint64_t countAllocations(Func&& f)
+{
+    allocations.store(0);
+    counting.store(true);
+    f();
+    counting.store(false);
+    return allocations.load();
+}
+
+static std::vector<PixelBufferBase> makeSlots(std::vector<unsigned char>& memory,
+                                              size_t frameSize, int num)
+{
+    memory.assign(frameSize * num, 0);
+    std::vector<PixelBufferBase> slots;
+    for (int i = 0; i < num; i++) {
+        slots.push_back(PixelBufferBase(memory.data() + i * frameSize,
+                                        frameSize, 64, 16, 0, i));
+    }
+    return slots;
+}
+
+// one camera, frames of a block each
+static std::string writeSession(int frames)
+{
+    using namespace session;
+
+    char path[] = "/tmp/framepool_testXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        std::perror("mkstemp");
+        std::exit(1);
+    }
+
+    uint64_t indexOffset = blockSize + frames * 2 * blockSize;
+    std::vector<unsigned char> file(indexOffset + blockSize, 0);
+
+    FileHeader header = {};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = version;
+    header.pixelFormat = 0;
+    header.width = 64;
+    header.height = 16;
+    header.cameraNum = 1;
+    header.frameSize = blockSize;
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    for (int i = 0; i < frames; i++) {
+        uint64_t offset = blockSize + i * 2 * blockSize;
+        RecordHeader record = {recordMagic, 0, i * 33333LL,
+                               static_cast<uint32_t>(i),
+                               static_cast<uint32_t>(blockSize)};
+        std::memcpy(file.data() + offset, &record, sizeof(record));
+
+        IndexEntry entry = {offset + blockSize, i * 33333LL, 0,
+                            static_cast<uint32_t>(i),
+                            static_cast<uint32_t>(blockSize), 0};
+        std::memcpy(file.data() + indexOffset + i * sizeof(entry), &entry,
+                    sizeof(entry));
+    }
+
+    Trailer trailer = {};
+    trailer.indexOffset = indexOffset;
+    trailer.entryCount = frames;
+    std::memcpy(trailer.magic, trailerMagic, sizeof(trailerMagic));
+    std::memcpy(file.data() + file.size() - sizeof(trailer), &trailer,
+                sizeof(trailer));
+
+    if (write(fd, file.data(), file.size()) != static_cast<ssize_t>(file.size())) {
+        std::perror("write");
+        std::exit(1);
+    }
+    close(fd);
+
+    return path;
+}
+
+static void testSlotPool()
+{
+    std::vector<unsigned char> memory;
+    SlotPool pool(makeSlots(memory, 4096, 4));
+
+    uint64_t n = countAllocations([&] {
+        for (int i = 0; i < 1000; i++) {
+            int slot = pool.acquire();
+            CHECK(slot != -1);
+            auto frame = pool.wrap(slot);
+            CHECK(frame->getStart() == pool.at(slot).getStart());
+        }
+    });
+    CHECK(n == 0);
+    CHECK(pool.getHeapAllocCount() == 0);
+}
+
+static void testReplaySource()
+{
+    std::string path = writeSession(3);
+    std::vector<unsigned char> memory;
+    std::vector<PixelBufferBase> slots = makeSlots(memory, 4096, 4);
+
+    {
+        ReplaySource source(slots, std::make_shared<session::Reader>(path),
+                            0, 0.0);
+        source.start();
+
+        // all frames in flight at once, then dropped in a different order
+        std::vector<std::shared_ptr<PixelBufferBase>> held;
+        held.reserve(slots.size());
+        uint64_t n = countAllocations([&] {
+            for (int round = 0; round < 100; round++) {
+                for (size_t i = 0; i < slots.size(); i++) {
+                    auto frame = source.dequeBuffer();
+                    CHECK(frame != nullptr);
+                    held.push_back(std::move(frame));
+                }
+                // every slot is taken, the source has nothing to give
+                CHECK(source.dequeBuffer() == nullptr);
+                held.erase(held.begin() + 1);
+                held.clear();
+            }
+        });
+        CHECK(n == 0);
+        CHECK(source.getHeapAllocCount() == 0);
+    }
+
+    unlink(path.c_str());
+}
+
+static void testExhausted()
+{
+    FramePool pool(64, 2);
+
+    void* a = pool.allocate(64);
+    void* b = pool.allocate(64);
+    CHECK(pool.getHeapAllocCount() == 0);
+
+    // past the blocks, and larger than one, both go to the heap
+    void* c = pool.allocate(64);
+    void* d = pool.allocate(128);
+    CHECK(pool.getHeapAllocCount() == 2);
+
+    pool.deallocate(d);
+    pool.deallocate(c);
+    pool.deallocate(b);
+    pool.deallocate(a);
+
+    // the blocks are free again
+    a = pool.allocate(64);
+    b = pool.allocate(64);
+    CHECK(pool.getHeapAllocCount() == 2);
+    pool.deallocate(a);
+    pool.deallocate(b);
+}
+
+int main()
+{
+    testSlotPool();
+    testReplaySource();
+    testExhausted();
+
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * the MJPEG decoder: frames pushed at the camera's pace are all decoded
+ * into the slots, a burst only keeps the newest, and broken frames are
+ * counted as dropped
+ */
+#include "jpegdecoder.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static const int width = 1280;
+static const int height = 800;
+
+// a gradient, compressed the way a camera would with 4:2:0 chroma
+static std::vector<unsigned char> encodeFrame()
+{
+    std::vector<unsigned char> rgb(width * height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = &rgb[(y * width + x) * 3];
+            p[0] = x * 255 / width;
+            p[1] = y * 255 / height;
+            p[2] = (x ^ y) & 255;
+        }
+    }
+
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char* out = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &out, &size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &rgb[cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+
+    std::vector<unsigned char> jpeg(out, out + size);
+    std::free(out);
+    jpeg_destroy_compress(&cinfo);
+
+    return jpeg;
+}
+
+struct Fixture
+{
+    std::vector<unsigned char> memory;
+    std::vector<PixelBufferBase> slots;
+    FrameSync sync;
+    FrameChannel frames;
+
+    explicit Fixture(int slotNum) :
+        memory(static_cast<size_t>(width) * height * 4 * slotNum),
+        sync(1, 1000, 1000),
+        frames(1)
+    {
+        size_t size = static_cast<size_t>(width) * height * 4;
+        for (int i = 0; i < slotNum; i++) {
+            slots.emplace_back(memory.data() + i * size, size, width, height,
+                               0, i);
+        }
+    }
+
+    // what the renderer would take, the frames must go back to the
+    // decoder's slots before it is destroyed
+    int take()
+    {
+        return frames.takeAll([](std::shared_ptr<PixelBufferBase>&) {});
+    }
+};
+
+static std::shared_ptr<PixelBufferBase> wrap(std::vector<unsigned char>& jpeg)
+{
+    return std::make_shared<PixelBufferBase>(jpeg.data(), jpeg.size(),
+                                             width, height, 0, 0);
+}
+
+// each frame sits in the channel until the next replaces it
+static void waitDecoded(const JpegDecoder& decoder, uint64_t count)
+{
+    for (int i = 0; i < 500 && decoder.getDecodeCount() +
+                                decoder.getDropCount() < count; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+static void testPaced(std::vector<unsigned char>& jpeg)
+{
+    Fixture fixture(4);
+    JpegDecoder decoder(fixture.slots, fixture.sync, fixture.frames, []{});
+    decoder.start();
+
+    for (int i = 0; i < 5; i++) {
+        decoder.push(wrap(jpeg));
+        waitDecoded(decoder, i + 1);
+    }
+    decoder.stop();
+
+    CHECK(fixture.take() == 1);
+    CHECK(decoder.getDecodeCount() == 5);
+    CHECK(decoder.getDropCount() == 0);
+    CHECK(decoder.getAvgDecodeUs() > 0);
+}
+
+// the decoder only gets to some of a burst, but always to the last one
+static void testBurst(std::vector<unsigned char>& jpeg)
+{
+    const int frames = 20;
+    Fixture fixture(4);
+    JpegDecoder decoder(fixture.slots, fixture.sync, fixture.frames, []{});
+    decoder.start();
+
+    for (int i = 0; i < frames; i++) {
+        decoder.push(wrap(jpeg));
+    }
+    waitDecoded(decoder, frames);
+    decoder.stop();
+
+    CHECK(fixture.take() == 1);
+    CHECK(decoder.getDecodeCount() >= 1);
+    CHECK(decoder.getDecodeCount() + decoder.getDropCount() == frames);
+}
+
+static void testBroken(std::vector<unsigned char>& jpeg)
+{
+    Fixture fixture(4);
+    JpegDecoder decoder(fixture.slots, fixture.sync, fixture.frames, []{});
+    decoder.start();
+
+    std::vector<unsigned char> junk(1000, 7);
+    decoder.push(wrap(junk));
+    waitDecoded(decoder, 1);
+    decoder.push(wrap(jpeg));
+    waitDecoded(decoder, 2);
+    decoder.stop();
+
+    CHECK(fixture.take() == 1);
+    CHECK(decoder.getDropCount() == 1);
+    CHECK(decoder.getDecodeCount() == 1);
+}
+
+int main()
+{
+    std::vector<unsigned char> jpeg = encodeFrame();
+
+    testPaced(jpeg);
+    testBurst(jpeg);
+    testBroken(jpeg);
+
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * the message ring: a handler must see the queue as it is behind the
+ * message being handled, messages come out in order once the ring wraps,
+ * and no message of several producers is lost
+ */
+#include "message.hpp"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+struct Number
+{
+    int value;
+};
+
+// what a handler saw of the queue behind its message
+static void testHandlerSeesRest()
+{
+    messaging::Receiver incoming;
+    messaging::Sender sender(incoming);
+    bool closed = false;
+    bool empty = false;
+    bool armed = false;
+
+    sender.send(Number{1});
+    incoming.wait(closed)
+        .handle<Number>(
+            [&](const Number&)
+            {
+                empty = incoming.empty();
+                armed = incoming.armWakeup();
+            }
+        );
+    CHECK(empty);
+    CHECK(armed);
+
+    // armed, so the next push makes the eventfd readable
+    sender.send(Number{2});
+    incoming.clearWakeup();
+    sender.send(Number{3});
+    incoming.wait(closed)
+        .handle<Number>(
+            [&](const Number& msg)
+            {
+                CHECK(msg.value == 2);
+                empty = incoming.empty();
+                armed = incoming.armWakeup();
+            }
+        );
+    CHECK(!empty);
+    CHECK(!armed);
+
+    incoming.wait(closed)
+        .handle<Number>(
+            [&](const Number& msg)
+            {
+                CHECK(msg.value == 3);
+                empty = incoming.empty();
+            }
+        );
+    CHECK(empty);
+}
+
+// many laps of a small ring
+static void testWrap()
+{
+    messaging::Queue q(4);
+    int next = 0;
+
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 3; i++) {
+            q.push(Number{round * 3 + i});
+        }
+        for (int i = 0; i < 3; i++) {
+            q.waitAndConsume(
+                [&](messaging::MessageBase* msg)
+                {
+                    auto wrapped =
+                        static_cast<messaging::WrappedMessage<Number>*>(msg);
+                    CHECK(wrapped->contents.value == next);
+                    next++;
+                    return true;
+                });
+        }
+        CHECK(q.empty());
+    }
+}
+
+// producers block on a full ring until the reader frees a slot
+static void testProducers()
+{
+    const int producers = 4;
+    const int perProducer = 20000;
+    messaging::Queue q(8);
+    std::vector<int> last(producers, -1);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back(
+            [&q, p]()
+            {
+                for (int i = 0; i < perProducer; i++) {
+                    q.push(Number{p * perProducer + i});
+                }
+            });
+    }
+
+    for (int n = 0; n < producers * perProducer; n++) {
+        q.waitAndConsume(
+            [&](messaging::MessageBase* msg)
+            {
+                int value =
+                    static_cast<messaging::WrappedMessage<Number>*>(msg)
+                        ->contents.value;
+                int p = value / perProducer;
+                // each producer's messages keep their order
+                CHECK(value % perProducer == last[p] + 1);
+                last[p] = value % perProducer;
+                return true;
+            });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(q.empty());
+    for (int p = 0; p < producers; p++) {
+        CHECK(last[p] == perProducer - 1);
+    }
+}
+
+int main()
+{
+    testHandlerSeesRest();
+    testWrap();
+    testProducers();
+
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}